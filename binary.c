@@ -0,0 +1,465 @@
+#include "binary.h"
+#include "traverse.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+#include "../range/string.h"
+
+#define JSON_BINARY_INTEGER_LIMIT 9007199254740992.0
+
+static void _write_bytes (window_char * output, const void * bytes, size_t size)
+{
+    const char * i = bytes;
+    const char * end = i + size;
+
+    while (i < end)
+    {
+	*window_push (*output) = *i++;
+    }
+}
+
+static void _write_tag (window_char * output, json_binary_tag tag)
+{
+    *window_push (*output) = (char) tag;
+}
+
+static void _write_varint (window_char * output, uint64_t number)
+{
+    while (number >= 0x80)
+    {
+	*window_push (*output) = (char) ((number & 0x7f) | 0x80);
+	number >>= 7;
+    }
+
+    *window_push (*output) = (char) number;
+}
+
+static void _write_zigzag (window_char * output, int64_t integer)
+{
+    _write_varint (output, ((uint64_t) integer << 1) ^ (uint64_t) (integer >> 63));
+}
+
+static void _write_integer (window_char * output, int64_t integer)
+{
+    _write_tag (output, JSON_BINARY_INTEGER);
+    _write_zigzag (output, integer);
+}
+
+static void _write_number (window_char * output, double number)
+{
+    // The range check goes first, converting a double outside of int64 is undefined
+    if (-JSON_BINARY_INTEGER_LIMIT < number && number < JSON_BINARY_INTEGER_LIMIT
+	&& number == (double)(int64_t) number
+	&& !(number == 0 && 1 / number < 0))
+    {
+	_write_integer (output, (int64_t) number);
+	return;
+    }
+
+    uint64_t bits;
+    unsigned char bytes[8];
+
+    memcpy (&bits, &number, sizeof(bits));
+
+    for (int i = 0; i < 8; i++)
+    {
+	bytes[i] = (unsigned char) (bits >> (8 * i));
+    }
+
+    _write_tag (output, JSON_BINARY_DOUBLE);
+    _write_bytes (output, bytes, sizeof(bytes));
+}
+
+static void _write_string (window_char * output, const char * string, size_t size)
+{
+    _write_varint (output, size);
+    _write_bytes (output, string, size);
+}
+
+bool json_encode_binary (window_char * output, const json_value * value)
+{
+    const json_value * element;
+    json_field_iterator fields;
+
+    value = json_resolve (value);
+
+    switch (value->type)
+    {
+    case JSON_NULL:
+	_write_tag (output, JSON_BINARY_NULL);
+	return true;
+
+    case JSON_TRUE:
+	_write_tag (output, JSON_BINARY_TRUE);
+	return true;
+
+    case JSON_FALSE:
+	_write_tag (output, JSON_BINARY_FALSE);
+	return true;
+
+    case JSON_NUMBER:
+	_write_number (output, json_number (value));
+	return true;
+
+    case JSON_STRING:
+	_write_tag (output, JSON_BINARY_STRING);
+	_write_string (output, value->string, value->count);
+	return true;
+
+    case JSON_ARRAY:
+	if (value->flags & JSON_FLAG_PACKED_INT64)
+	{
+	    _write_tag (output, JSON_BINARY_INTEGERS);
+	    _write_varint (output, value->count);
+
+	    for (size_t i = 0; i < value->count; i++)
+	    {
+		_write_zigzag (output, value->integers[i]);
+	    }
+
+	    return true;
+	}
+
+	_write_tag (output, JSON_BINARY_ARRAY);
+	_write_varint (output, value->count);
+
+	if (value->flags & JSON_FLAG_PACKED_DOUBLE)
+	{
+	    for (size_t i = 0; i < value->count; i++)
+	    {
+		_write_number (output, value->doubles[i]);
+	    }
+
+	    return true;
+	}
+
+	for_range (element, json_elements (value))
+	{
+	    if (!json_encode_binary (output, element))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    case JSON_OBJECT:
+	_write_tag (output, JSON_BINARY_OBJECT);
+	_write_varint (output, json_object_size (value));
+
+	fields = json_field_iterator (value);
+
+	while (json_field_next (&fields))
+	{
+	    _write_string (output, fields.key.begin, range_count (fields.key));
+
+	    if (!json_encode_binary (output, fields.value))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    default:
+    case JSON_BADTYPE:
+	log_fatal ("Cannot encode a value of type %s", json_type_name (value->type));
+    }
+
+fail:
+    return false;
+}
+
+static bool _read_varint (uint64_t * number, range_const_char * input)
+{
+    unsigned char byte;
+    int shift = 0;
+
+    *number = 0;
+
+    while (input->begin < input->end && shift < 64)
+    {
+	byte = (unsigned char) *input->begin++;
+	*number |= (uint64_t) (byte & 0x7f) << shift;
+
+	if (!(byte & 0x80))
+	{
+	    return true;
+	}
+
+	shift += 7;
+    }
+
+    log_fatal ("Binary input ended within a varint");
+
+fail:
+    return false;
+}
+
+static bool _read_size (size_t * size, range_const_char * input)
+{
+    uint64_t number;
+
+    if (!_read_varint (&number, input))
+    {
+	return false;
+    }
+
+    if (number > (uint64_t) range_count (*input))
+    {
+	log_fatal ("Binary length %llu runs past the end of the input", (unsigned long long) number);
+    }
+
+    *size = (size_t) number;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _read_double (double * number, range_const_char * input)
+{
+    uint64_t bits = 0;
+
+    if (range_count (*input) < 8)
+    {
+	log_fatal ("Binary input ended within a number");
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+	bits |= (uint64_t) (unsigned char) input->begin[i] << (8 * i);
+    }
+
+    memcpy (number, &bits, sizeof(*number));
+
+    input->begin += 8;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _read_bytes (range_const_char * bytes, range_const_char * input)
+{
+    size_t size;
+
+    if (!_read_size (&size, input))
+    {
+	return false;
+    }
+
+    bytes->begin = input->begin;
+    bytes->end = input->begin + size;
+
+    input->begin = bytes->end;
+
+    return true;
+}
+
+static bool _read_value (json_value * value, range_const_char * input)
+{
+    range_const_char bytes;
+    uint64_t integer;
+    size_t count;
+    json_value * element;
+    json_pair * pair;
+
+    *value = (json_value){0};
+
+    if (input->begin == input->end)
+    {
+	log_fatal ("Binary input ended before a value");
+    }
+
+    switch ((json_binary_tag) *input->begin++)
+    {
+    case JSON_BINARY_NULL:
+	value->type = JSON_NULL;
+	return true;
+
+    case JSON_BINARY_TRUE:
+	value->type = JSON_TRUE;
+	return true;
+
+    case JSON_BINARY_FALSE:
+	value->type = JSON_FALSE;
+	return true;
+
+    case JSON_BINARY_INTEGER:
+	if (!_read_varint (&integer, input))
+	{
+	    return false;
+	}
+	value->type = JSON_NUMBER;
+	value->number = (double) (int64_t) ((integer >> 1) ^ -(integer & 1));
+	return true;
+
+    case JSON_BINARY_DOUBLE:
+	value->type = JSON_NUMBER;
+	return _read_double (&value->number, input);
+
+    case JSON_BINARY_STRING:
+	if (!_read_bytes (&bytes, input))
+	{
+	    return false;
+	}
+
+	if ((uint64_t) range_count (bytes) > UINT32_MAX)
+	{
+	    log_fatal ("Binary string is longer than %u bytes", (unsigned) UINT32_MAX);
+	}
+
+	value->string = range_strdup_to_string (&bytes);
+
+	if (!value->string)
+	{
+	    perror ("malloc");
+	    return false;
+	}
+
+	value->count = range_count (bytes);
+	value->type = JSON_STRING;
+	return true;
+
+    case JSON_BINARY_ARRAY:
+	if (!_read_size (&count, input))
+	{
+	    return false;
+	}
+
+	value->type = JSON_ARRAY;
+
+	if (!count)
+	{
+	    return true;
+	}
+
+	if (count > UINT32_MAX)
+	{
+	    log_fatal ("Binary array has more than %u elements", (unsigned) UINT32_MAX);
+	}
+
+	value->elements = calloc (count, sizeof(*value->elements));
+
+	if (!value->elements)
+	{
+	    perror ("calloc");
+	    return false;
+	}
+
+	value->count = count;
+
+	for_range (element, json_elements (value))
+	{
+	    if (!_read_value (element, input))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    case JSON_BINARY_INTEGERS:
+	if (!_read_size (&count, input))
+	{
+	    return false;
+	}
+
+	value->type = JSON_ARRAY;
+
+	if (!count)
+	{
+	    return true;
+	}
+
+	if (count > UINT32_MAX)
+	{
+	    log_fatal ("Binary array has more than %u elements", (unsigned) UINT32_MAX);
+	}
+
+	value->integers = malloc (count * sizeof(*value->integers));
+
+	if (!value->integers)
+	{
+	    perror ("malloc");
+	    return false;
+	}
+
+	value->flags = JSON_FLAG_PACKED_INT64;
+	value->count = count;
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    if (!_read_varint (&integer, input))
+	    {
+		return false;
+	    }
+
+	    value->integers[i] = (int64_t) ((integer >> 1) ^ -(integer & 1));
+	}
+
+	return true;
+
+    case JSON_BINARY_OBJECT:
+	if (!_read_size (&count, input))
+	{
+	    return false;
+	}
+
+	value->object = calloc (1, sizeof(*value->object));
+
+	if (!value->object)
+	{
+	    perror ("calloc");
+	    return false;
+	}
+
+	value->type = JSON_OBJECT;
+
+	while (count--)
+	{
+	    if (!_read_bytes (&bytes, input))
+	    {
+		return false;
+	    }
+
+	    pair = json_include_range (value->object, &bytes);
+	    json_value_clear (&pair->value);
+
+	    if (!_read_value (&pair->value, input))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    default:
+	log_fatal ("Unrecognized binary tag %d", (int) (unsigned char) input->begin[-1]);
+    }
+
+fail:
+    return false;
+}
+
+json_value * json_decode_binary (const range_const_char * input)
+{
+    range_const_char text = *input;
+
+    json_value * value = calloc (1, sizeof(*value));
+
+    if (!_read_value (value, &text))
+    {
+	json_value_free (value);
+	return NULL;
+    }
+
+    return value;
+}
@@ -0,0 +1,38 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include "def.h"
+#include "../window/def.h"
+#endif
+
+/*
+  Binary layout, one tag byte per value followed by its payload:
+
+  JSON_BINARY_NULL, JSON_BINARY_TRUE, JSON_BINARY_FALSE: no payload
+  JSON_BINARY_INTEGER: zigzag varint, used for integral numbers that fit in 53 bits
+  JSON_BINARY_DOUBLE: 8 bytes, little endian IEEE 754
+  JSON_BINARY_STRING: varint byte count, then the bytes (no terminator)
+  JSON_BINARY_ARRAY: varint element count, then each element
+  JSON_BINARY_OBJECT: varint pair count, then each key (varint byte count and bytes) followed by its value
+  JSON_BINARY_INTEGERS: varint element count, then each element as a zigzag varint of all 64 bits, for packed int64 arrays
+
+  Varints are little endian base 128, 7 bits per byte with the high bit set on every byte but the last.
+
+  A json_value number is a double, so other numbers beyond 53 bits, including lazy ones, are written
+  and decoded as doubles. Packed int64 arrays decode back into packed int64 arrays with every bit intact.
+*/
+
+typedef enum json_binary_tag {
+    JSON_BINARY_NULL,
+    JSON_BINARY_INTEGER,
+    JSON_BINARY_DOUBLE,
+    JSON_BINARY_TRUE,
+    JSON_BINARY_FALSE,
+    JSON_BINARY_STRING,
+    JSON_BINARY_ARRAY,
+    JSON_BINARY_OBJECT,
+    JSON_BINARY_INTEGERS,
+}
+    json_binary_tag;
+
+bool json_encode_binary (window_char * output, const json_value * value);
+json_value * json_decode_binary (const range_const_char * input);
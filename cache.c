@@ -0,0 +1,565 @@
+#include "cache.h"
+#include "traverse.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../window/def.h"
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+#define JSON_CACHE_BYTE_ORDER 0x01020304
+
+#define _at(output, offset, type) ((type*) ((output)->region.begin + (offset)))
+
+static size_t _reserve_bytes (window_char * output, size_t size)
+{
+    size_t offset = range_count (output->region);
+
+    while (size--)
+    {
+	*window_push (*output) = 0;
+    }
+
+    return offset;
+}
+
+static size_t _reserve_aligned (window_char * output, size_t size)
+{
+    while (range_count (output->region) % sizeof(int64_t))
+    {
+	*window_push (*output) = 0;
+    }
+
+    return _reserve_bytes (output, size);
+}
+
+static int _compare_key (const char * a, size_t a_length, const char * b, size_t b_length)
+{
+    int result = memcmp (a, b, a_length < b_length ? a_length : b_length);
+
+    if (result)
+    {
+	return result;
+    }
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+typedef struct json_cache_field json_cache_field;
+struct json_cache_field {
+    range_const_char key;
+    const json_value * value;
+};
+
+static int _compare_fields (const void * a, const void * b)
+{
+    const json_cache_field * a_field = a;
+    const json_cache_field * b_field = b;
+
+    return _compare_key (a_field->key.begin, range_count (a_field->key),
+			 b_field->key.begin, range_count (b_field->key));
+}
+
+static bool _write_node (window_char * output, size_t node_offset, const json_value * value);
+
+static bool _write_string (window_char * output, size_t node_offset, const json_value * value)
+{
+    size_t length = value->count;
+    size_t offset = _reserve_bytes (output, length + 1);
+
+    memcpy (output->region.begin + offset, value->string, length);
+
+    json_cache_node * node = _at (output, node_offset, json_cache_node);
+    node->count = length;
+    node->offset = (int64_t) offset - (int64_t) node_offset;
+
+    return true;
+}
+
+static bool _write_array (window_char * output, size_t node_offset, const json_value * value)
+{
+    size_t count = value->count;
+    size_t offset = _reserve_aligned (output, count * sizeof(json_cache_node));
+
+    json_cache_node * node = _at (output, node_offset, json_cache_node);
+    node->count = count;
+    node->offset = (int64_t) offset - (int64_t) node_offset;
+
+    if (json_is_packed (value))
+    {
+	json_number_array numbers = json_packed_numbers (value);
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    node = _at (output, offset + i * sizeof(json_cache_node), json_cache_node);
+	    node->type = JSON_NUMBER;
+	    node->number = json_number_at (&numbers, i);
+	}
+
+	return true;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+	if (!_write_node (output, offset + i * sizeof(json_cache_node), value->elements + i))
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+static bool _write_object (window_char * output, size_t node_offset, const json_value * value)
+{
+    size_t count = json_object_size (value);
+    json_field_iterator fields = json_field_iterator (value);
+
+    json_cache_field * sorted = calloc (count + 1, sizeof(*sorted));
+
+    if (!sorted)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    count = 0;
+
+    while (json_field_next (&fields))
+    {
+	sorted[count++] = (json_cache_field){ .key = fields.key, .value = fields.value };
+    }
+
+    qsort (sorted, count, sizeof(*sorted), _compare_fields);
+
+    size_t offset = _reserve_aligned (output, count * sizeof(json_cache_entry));
+
+    json_cache_node * node = _at (output, node_offset, json_cache_node);
+    node->count = count;
+    node->offset = (int64_t) offset - (int64_t) node_offset;
+
+    for (size_t i = 0; i < count; i++)
+    {
+	size_t entry_offset = offset + i * sizeof(json_cache_entry);
+	size_t key_length = range_count (sorted[i].key);
+	size_t key_offset = _reserve_bytes (output, key_length + 1);
+
+	memcpy (output->region.begin + key_offset, sorted[i].key.begin, key_length);
+
+	json_cache_entry * entry = _at (output, entry_offset, json_cache_entry);
+	entry->key = (int64_t) key_offset - (int64_t) entry_offset;
+	entry->key_length = key_length;
+
+	if (!_write_node (output, entry_offset + offsetof(json_cache_entry, value), sorted[i].value))
+	{
+	    free (sorted);
+	    return false;
+	}
+    }
+
+    free (sorted);
+
+    return true;
+}
+
+static bool _write_node (window_char * output, size_t node_offset, const json_value * value)
+{
+    json_cache_node * node = _at (output, node_offset, json_cache_node);
+
+    value = json_resolve (value);
+
+    node->type = value->type;
+
+    switch (value->type)
+    {
+    case JSON_NULL:
+    case JSON_TRUE:
+    case JSON_FALSE:
+	return true;
+
+    case JSON_NUMBER:
+	node->number = json_number (value);
+	return true;
+
+    case JSON_STRING:
+	return _write_string (output, node_offset, value);
+
+    case JSON_ARRAY:
+	return _write_array (output, node_offset, value);
+
+    case JSON_OBJECT:
+	return _write_object (output, node_offset, value);
+
+    default:
+    case JSON_BADTYPE:
+	log_fatal ("Cannot cache a value of type %s", json_type_name (value->type));
+    }
+
+fail:
+    return false;
+}
+
+bool json_cache_save (const char * path, const json_value * value)
+{
+    window_char output = {0};
+    FILE * file = NULL;
+
+    size_t header_offset = _reserve_aligned (&output, sizeof(json_cache_header));
+
+    if (!_write_node (&output, header_offset + offsetof(json_cache_header, root), value))
+    {
+	goto fail;
+    }
+
+    json_cache_header * header = _at (&output, header_offset, json_cache_header);
+
+    memcpy (header->magic, JSON_CACHE_MAGIC, sizeof(header->magic));
+    header->version = JSON_CACHE_VERSION;
+    header->byte_order = JSON_CACHE_BYTE_ORDER;
+    header->size = range_count (output.region);
+
+    file = fopen (path, "wb");
+
+    if (!file)
+    {
+	perror (path);
+	goto fail;
+    }
+
+    if ((size_t) range_count (output.region) != fwrite (output.region.begin, 1, range_count (output.region), file))
+    {
+	perror (path);
+	goto fail;
+    }
+
+    if (0 != fclose (file))
+    {
+	file = NULL;
+	perror (path);
+	goto fail;
+    }
+
+    free (output.alloc.begin);
+
+    return true;
+
+fail:
+    if (file)
+    {
+	fclose (file);
+    }
+
+    free (output.alloc.begin);
+
+    return false;
+}
+
+bool json_cache_open (json_cache * cache, const char * path)
+{
+    struct stat info;
+    const json_cache_header * header;
+    void * map = MAP_FAILED;
+
+    *cache = (json_cache){0};
+
+    int fd = open (path, O_RDONLY);
+
+    if (fd < 0)
+    {
+	perror (path);
+	return false;
+    }
+
+    if (0 != fstat (fd, &info))
+    {
+	perror (path);
+	goto fail;
+    }
+
+    if ((size_t) info.st_size < sizeof(json_cache_header))
+    {
+	log_fatal ("%s is too small to be a json cache", path);
+    }
+
+    map = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+	perror ("mmap");
+	goto fail;
+    }
+
+    header = map;
+
+    if (0 != memcmp (header->magic, JSON_CACHE_MAGIC, sizeof(header->magic)))
+    {
+	log_fatal ("%s is not a json cache", path);
+    }
+
+    if (header->version != JSON_CACHE_VERSION || header->byte_order != JSON_CACHE_BYTE_ORDER)
+    {
+	log_fatal ("%s was written by an incompatible version or host", path);
+    }
+
+    if (header->size != (uint64_t) info.st_size)
+    {
+	log_fatal ("%s is truncated", path);
+    }
+
+    close (fd);
+
+    cache->begin = map;
+    cache->size = info.st_size;
+
+    return true;
+
+fail:
+    if (map != MAP_FAILED)
+    {
+	munmap (map, info.st_size);
+    }
+
+    close (fd);
+
+    return false;
+}
+
+void json_cache_close (json_cache * cache)
+{
+    if (cache->begin)
+    {
+	munmap ((void*) cache->begin, cache->size);
+    }
+
+    *cache = (json_cache){0};
+}
+
+const json_cache_node * json_cache_root (const json_cache * cache)
+{
+    return &((const json_cache_header*) cache->begin)->root;
+}
+
+const json_cache_node * json_cache_lookup (const json_cache_node * object, const char * key)
+{
+    assert (object->type == JSON_OBJECT);
+
+    const json_cache_entry * entries = (const json_cache_entry*) json_cache_target (object);
+    size_t key_length = strlen (key);
+    size_t low = 0;
+    size_t high = object->count;
+    size_t middle;
+    int compare;
+
+    while (low < high)
+    {
+	middle = low + (high - low) / 2;
+
+	compare = _compare_key (key, key_length, json_cache_entry_key (entries + middle), entries[middle].key_length);
+
+	if (compare == 0)
+	{
+	    return &entries[middle].value;
+	}
+	else if (compare < 0)
+	{
+	    high = middle;
+	}
+	else
+	{
+	    low = middle + 1;
+	}
+    }
+
+    return NULL;
+}
+
+json_cache_array json_cache_elements (const json_cache_node * array)
+{
+    assert (array->type == JSON_ARRAY);
+
+    const json_cache_node * begin = (const json_cache_node*) json_cache_target (array);
+
+    return (json_cache_array){ .begin = begin, .end = begin + array->count };
+}
+
+const char * json_cache_string (const json_cache_node * string)
+{
+    assert (string->type == JSON_STRING);
+
+    return json_cache_target (string);
+}
+
+range_const_char json_cache_string_range (const json_cache_node * string)
+{
+    assert (string->type == JSON_STRING);
+
+    return (range_const_char){ .begin = json_cache_target (string), .end = json_cache_target (string) + string->count };
+}
+
+keyargs_define(json_cache_get_bool)
+{
+    const json_cache_node * node = json_cache_lookup (args.parent, args.key);
+
+    if (!node || node->type == JSON_NULL)
+    {
+	if (args.optional)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (node->type == JSON_TRUE)
+    {
+	return true;
+    }
+    else if (node->type == JSON_FALSE)
+    {
+	return false;
+    }
+    else
+    {
+	log_fatal ("Object child %s is not a boolean value", args.key);
+    }
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return false;
+}
+
+keyargs_define(json_cache_get_number)
+{
+    const json_cache_node * node = json_cache_lookup (args.parent, args.key);
+
+    if (!node || node->type == JSON_NULL)
+    {
+	if (args.optional)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (node->type != JSON_NUMBER)
+    {
+	log_fatal ("Object child %s is not a number", args.key);
+    }
+
+    return node->number;
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return 0;
+}
+
+keyargs_define(json_cache_get_string)
+{
+    const json_cache_node * node = json_cache_lookup (args.parent, args.key);
+
+    if (!node || node->type == JSON_NULL)
+    {
+	if (args.optional && args.default_value)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (node->type != JSON_STRING)
+    {
+	log_fatal ("Object child %s is not a string", args.key);
+    }
+
+    return json_cache_string (node);
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return NULL;
+}
+
+keyargs_define(json_cache_get_array)
+{
+    const json_cache_node * node = json_cache_lookup (args.parent, args.key);
+
+    if (!node || node->type == JSON_NULL)
+    {
+	if (!args.optional)
+	{
+	    log_fatal ("Object has no child %s", args.key);
+	}
+	else
+	{
+	    return (json_cache_array){0};
+	}
+    }
+
+    if (node->type != JSON_ARRAY)
+    {
+	log_fatal ("Object child %s is not an array", args.key);
+    }
+
+    return json_cache_elements (node);
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return (json_cache_array){0};
+}
+
+keyargs_define(json_cache_get_object)
+{
+    const json_cache_node * node = json_cache_lookup (args.parent, args.key);
+
+    if (!node || node->type == JSON_NULL)
+    {
+	if (!args.optional)
+	{
+	    log_fatal ("Object has no child %s", args.key);
+	}
+	else
+	{
+	    return NULL;
+	}
+    }
+
+    if (node->type != JSON_OBJECT)
+    {
+	log_fatal ("Object child %s is not an object", args.key);
+    }
+
+    return node;
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return NULL;
+}
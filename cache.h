@@ -0,0 +1,104 @@
+#ifndef FLAT_INCLUDES
+#include <stdint.h>
+#include <stdbool.h>
+#include "def.h"
+#include "../keyargs/keyargs.h"
+#endif
+
+/*
+  A json_cache file is a relocatable image of a parsed document that is
+  read in place through mmap. Every node is 16 bytes and refers to its
+  payload with an offset relative to the node itself, so the image works
+  at any address without fixups. Object entries are sorted by key and
+  searched with a binary search. The image uses the byte order of the
+  host that wrote it.
+*/
+
+#define JSON_CACHE_MAGIC "jsoncach"
+#define JSON_CACHE_VERSION 1
+
+typedef struct json_cache_node json_cache_node;
+struct json_cache_node {
+    uint32_t type;
+    uint32_t count;
+    union {
+	double number;
+	int64_t offset;
+    };
+};
+
+typedef struct json_cache_entry json_cache_entry;
+struct json_cache_entry {
+    int64_t key;
+    uint64_t key_length;
+    json_cache_node value;
+};
+
+typedef struct json_cache_header json_cache_header;
+struct json_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    json_cache_node root;
+};
+
+range_typedef(json_cache_node, json_cache_node);
+typedef range_const_json_cache_node json_cache_array;
+
+typedef struct json_cache json_cache;
+struct json_cache {
+    const char * begin;
+    size_t size;
+};
+
+#define json_cache_target(node) ((const char*)(node) + (node)->offset)
+#define json_cache_entry_key(entry) ((const char*)(entry) + (entry)->key)
+
+bool json_cache_save (const char * path, const json_value * value);
+bool json_cache_open (json_cache * cache, const char * path);
+void json_cache_close (json_cache * cache);
+
+const json_cache_node * json_cache_root (const json_cache * cache);
+const json_cache_node * json_cache_lookup (const json_cache_node * object, const char * key);
+json_cache_array json_cache_elements (const json_cache_node * array);
+const char * json_cache_string (const json_cache_node * string);
+range_const_char json_cache_string_range (const json_cache_node * string);
+
+#define json_cache_get_number(...) keyargs_call(json_cache_get_number, __VA_ARGS__)
+keyargs_declare(double, json_cache_get_number,
+		const json_cache_node * parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		double default_value;);
+
+#define json_cache_get_bool(...) keyargs_call(json_cache_get_bool, __VA_ARGS__)
+keyargs_declare(bool, json_cache_get_bool,
+		const json_cache_node * parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		bool default_value;);
+
+#define json_cache_get_string(...) keyargs_call(json_cache_get_string, __VA_ARGS__)
+keyargs_declare(const char*, json_cache_get_string,
+		const json_cache_node * parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		const char * default_value;);
+
+#define json_cache_get_array(...) keyargs_call(json_cache_get_array, __VA_ARGS__)
+keyargs_declare(json_cache_array, json_cache_get_array,
+		const json_cache_node * parent;
+		const char * key;
+		bool optional;
+		bool * success;);
+
+#define json_cache_get_object(...) keyargs_call(json_cache_get_object, __VA_ARGS__)
+keyargs_declare(const json_cache_node*, json_cache_get_object,
+		const json_cache_node * parent;
+		const char * key;
+		bool * success;
+		bool optional;);
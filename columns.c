@@ -0,0 +1,301 @@
+#include "columns.h"
+#include "traverse.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+static json_column * _find (json_columns * columns, const range_const_char * key)
+{
+    json_column * column;
+    size_t size = range_count (*key);
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	column = columns->columns + i;
+
+	if (strlen (column->name) == size && 0 == memcmp (column->name, key->begin, size))
+	{
+	    return column;
+	}
+    }
+
+    return NULL;
+}
+
+static void _begin_row (json_columns * columns)
+{
+    json_column * column;
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	column = columns->columns + i;
+	column->filled = false;
+
+	if (column->type == JSON_STRING && range_is_empty (column->offsets.region))
+	{
+	    *window_push (column->offsets) = 0;
+	}
+
+	if (columns->rows % 8 == 0)
+	{
+	    *window_push (column->nulls) = 0;
+	}
+    }
+}
+
+static void _push_null (json_column * column, size_t row)
+{
+    column->nulls.region.begin[row / 8] |= (uint8_t) (1 << (row % 8));
+
+    if (column->type == JSON_NUMBER)
+    {
+	*window_push (column->numbers) = NAN;
+    }
+    else
+    {
+	*window_push (column->offsets) = range_count (column->strings.region);
+    }
+
+    column->filled = true;
+}
+
+static bool _read_field (json_column * column, size_t row, json_parser_context * context, range_const_char * input)
+{
+    const char * i;
+    json_type type = json_scan_next (input);
+
+    if (column->filled)
+    {
+	log_fatal ("Field %s appears twice in record %zu", column->name, row);
+    }
+
+    if (type == JSON_NULL)
+    {
+	if (!json_skip_value (context, input))
+	{
+	    return false;
+	}
+
+	_push_null (column, row);
+	return true;
+    }
+
+    if (type != column->type)
+    {
+	log_fatal ("Field %s is %s in record %zu, expected %s", column->name, json_type_name (type), row, json_type_name (column->type));
+    }
+
+    if (type == JSON_NUMBER)
+    {
+	if (!json_scan_number (window_push (column->numbers), input))
+	{
+	    column->numbers.region.end--;
+	    return false;
+	}
+    }
+    else
+    {
+	if (!json_scan_string (context, input))
+	{
+	    return false;
+	}
+
+	for_range (i, context->text.region)
+	{
+	    *window_push (column->strings) = *i;
+	}
+
+	*window_push (column->offsets) = range_count (column->strings.region);
+    }
+
+    column->filled = true;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _read_record (json_columns * columns, json_parser_context * context, range_const_char * input)
+{
+    size_t row = columns->rows;
+    json_column * column;
+
+    if (!json_scan_punctuation (input, '{'))
+    {
+	log_fatal ("Record %zu is not an object", row);
+    }
+
+    _begin_row (columns);
+
+    if (!json_scan_punctuation (input, '}'))
+    {
+	while (true)
+	{
+	    if (!json_scan_string (context, input) || !json_scan_punctuation (input, ':'))
+	    {
+		log_fatal ("Expected a key and separator in record %zu", row);
+	    }
+
+	    column = _find (columns, &context->text.region.alias_const);
+
+	    if (column ? !_read_field (column, row, context, input) : !json_skip_value (context, input))
+	    {
+		return false;
+	    }
+
+	    if (json_scan_punctuation (input, '}'))
+	    {
+		break;
+	    }
+
+	    if (!json_scan_punctuation (input, ','))
+	    {
+		log_fatal ("Expected ',' or '}' in record %zu", row);
+	    }
+	}
+    }
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	if (!columns->columns[i].filled)
+	{
+	    _push_null (columns->columns + i, row);
+	}
+    }
+
+    columns->rows++;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static void _truncate (json_columns * columns)
+{
+    json_column * column;
+    size_t rows = columns->rows;
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	column = columns->columns + i;
+
+	if (column->type == JSON_NUMBER)
+	{
+	    column->numbers.region.end = column->numbers.region.begin + rows;
+	}
+	else if (!range_is_empty (column->offsets.region))
+	{
+	    column->offsets.region.end = column->offsets.region.begin + rows + 1;
+	    column->strings.region.end = column->strings.region.begin + column->offsets.region.begin[rows];
+	}
+
+	column->nulls.region.end = column->nulls.region.begin + (rows + 7) / 8;
+
+	if (rows % 8)
+	{
+	    column->nulls.region.begin[rows / 8] &= (uint8_t) ((1 << (rows % 8)) - 1);
+	}
+    }
+}
+
+bool json_to_columns (json_columns * columns, json_parser_context * context, const range_const_char * input)
+{
+    range_const_char text = *input;
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	if (columns->columns[i].type != JSON_NUMBER && columns->columns[i].type != JSON_STRING)
+	{
+	    log_fatal ("Column %s must be a number or string column", columns->columns[i].name);
+	}
+    }
+
+    if (json_scan_punctuation (&text, '['))
+    {
+	if (!json_scan_punctuation (&text, ']'))
+	{
+	    while (true)
+	    {
+		if (!_read_record (columns, context, &text))
+		{
+		    goto fail;
+		}
+
+		if (json_scan_punctuation (&text, ']'))
+		{
+		    break;
+		}
+
+		if (!json_scan_punctuation (&text, ','))
+		{
+		    log_fatal ("Expected ',' or ']' after record %zu", columns->rows - 1);
+		}
+	    }
+	}
+    }
+    else
+    {
+	while (json_scan_next (&text) == JSON_OBJECT)
+	{
+	    if (!_read_record (columns, context, &text))
+	    {
+		goto fail;
+	    }
+	}
+    }
+
+    if (json_scan_next (&text) != JSON_BADTYPE || text.begin != text.end)
+    {
+	log_fatal ("Unexpected input after record %zu", columns->rows);
+    }
+
+    return true;
+
+fail:
+    _truncate (columns);
+    return false;
+}
+
+void json_columns_clear (json_columns * columns)
+{
+    json_column * column;
+
+    for (size_t i = 0; i < columns->count; i++)
+    {
+	column = columns->columns + i;
+	free (column->numbers.alloc.begin);
+	free (column->offsets.alloc.begin);
+	free (column->strings.alloc.begin);
+	free (column->nulls.alloc.begin);
+	*column = (json_column){ .name = column->name, .type = column->type };
+    }
+
+    columns->rows = 0;
+}
+
+bool json_column_is_null (const json_column * column, size_t row)
+{
+    return column->nulls.region.begin[row / 8] & (1 << (row % 8));
+}
+
+double json_column_number (const json_column * column, size_t row)
+{
+    assert (column->type == JSON_NUMBER);
+
+    return column->numbers.region.begin[row];
+}
+
+range_const_char json_column_string (const json_column * column, size_t row)
+{
+    assert (column->type == JSON_STRING);
+
+    return (range_const_char){ .begin = column->strings.region.begin + column->offsets.region.begin[row],
+	                       .end = column->strings.region.begin + column->offsets.region.begin[row + 1] };
+}
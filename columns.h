@@ -0,0 +1,54 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "def.h"
+#include "parse.h"
+#include "../window/def.h"
+#endif
+
+/*
+  Columnar extraction from arrays of records. The input is either a
+  top level array of objects or a stream of objects separated by
+  whitespace, as in NDJSON. Each column names a field and is either
+  JSON_NUMBER or JSON_STRING. Records are scanned once and never built
+  into json_objects: wanted fields are decoded straight into their
+  column, other fields are skipped. Numbers are packed into a double
+  per row, strings are concatenated with an offset per row, and a
+  missing or null field sets the row's bit in the null bitmap. Each
+  call appends rows, so a stream can be loaded in chunks of whole
+  records. On failure the columns hold the rows read before the bad
+  record.
+*/
+
+range_typedef(double, json_column_number);
+window_typedef(double, json_column_number);
+range_typedef(size_t, json_column_offset);
+window_typedef(size_t, json_column_offset);
+range_typedef(uint8_t, json_column_bits);
+window_typedef(uint8_t, json_column_bits);
+
+typedef struct json_column json_column;
+struct json_column {
+    const char * name;
+    json_type type;
+    bool filled;
+    window_json_column_number numbers;
+    window_json_column_offset offsets;
+    window_char strings;
+    window_json_column_bits nulls;
+};
+
+typedef struct json_columns json_columns;
+struct json_columns {
+    json_column * columns;
+    size_t count;
+    size_t rows;
+};
+
+bool json_to_columns (json_columns * columns, json_parser_context * context, const range_const_char * input);
+void json_columns_clear (json_columns * columns);
+
+bool json_column_is_null (const json_column * column, size_t row);
+double json_column_number (const json_column * column, size_t row);
+range_const_char json_column_string (const json_column * column, size_t row);
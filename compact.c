@@ -0,0 +1,1170 @@
+#include "compact.h"
+#include "traverse.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+#define JSON_COMPACT_NULL 0
+#define JSON_COMPACT_TRUE 1
+#define JSON_COMPACT_FALSE 2
+#define JSON_COMPACT_INTEGER 3
+#define JSON_COMPACT_DOUBLE 4
+#define JSON_COMPACT_STRING 5
+#define JSON_COMPACT_ARRAY 6
+#define JSON_COMPACT_OBJECT 7
+#define JSON_COMPACT_INTEGERS 8
+#define JSON_COMPACT_FLOATS 9
+#define JSON_COMPACT_DOUBLES 10
+
+// The low nibble of a tag is the kind, the rest holds the byte widths of offsets and keys as powers of two
+#define _kind(tag) ((tag) & 15)
+#define _width(tag) (1u << (((tag) >> 4) & 3))
+#define _key_width(tag) (1u << (((tag) >> 6) & 3))
+
+// Number arrays have no keys, so that bit instead records whether the source array was packed
+#define JSON_COMPACT_PACKED 64
+
+#define JSON_COMPACT_INITIAL_SLOTS 1024
+
+typedef struct json_compact_slot json_compact_slot;
+struct json_compact_slot {
+    uint64_t hash;
+    size_t offset; // one past the pool offset, zero for an empty slot
+};
+
+typedef struct json_compact_builder json_compact_builder;
+struct json_compact_builder {
+    window_char nodes;
+    window_char pool;
+    json_compact_slot * slots;
+    size_t slot_count;
+    size_t used;
+};
+
+typedef struct json_compact_member json_compact_member;
+struct json_compact_member {
+    range_const_char key;
+    const json_value * value;
+};
+
+typedef struct json_compact_container json_compact_container;
+struct json_compact_container {
+    size_t count;
+    unsigned width;
+    unsigned key_width;
+    const uint8_t * keys;
+    const uint8_t * offsets;
+    const uint8_t * body;
+};
+
+typedef struct json_compact_numbers json_compact_numbers;
+struct json_compact_numbers {
+    unsigned kind;
+    size_t count;
+    unsigned width;
+    int64_t minimum;
+    const uint8_t * data;
+};
+
+static void _write_varint (window_char * output, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+	*window_push (*output) = (char) (value | 0x80);
+	value >>= 7;
+    }
+
+    *window_push (*output) = (char) value;
+}
+
+static uint8_t * _store_varint (uint8_t * at, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+	*at++ = (uint8_t) (value | 0x80);
+	value >>= 7;
+    }
+
+    *at++ = (uint8_t) value;
+
+    return at;
+}
+
+static uint64_t _read_varint (const uint8_t ** at)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+
+    while (**at & 0x80)
+    {
+	value |= (uint64_t) (*(*at)++ & 0x7f) << shift;
+	shift += 7;
+    }
+
+    return value | (uint64_t) *(*at)++ << shift;
+}
+
+static size_t _varint_size (uint64_t value)
+{
+    size_t size = 1;
+
+    while (value >= 0x80)
+    {
+	value >>= 7;
+	size++;
+    }
+
+    return size;
+}
+
+static uint64_t _zigzag (int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t _unzigzag (uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static unsigned _width_code (uint64_t largest)
+{
+    return largest <= UINT8_MAX ? 0 : largest <= UINT16_MAX ? 1 : largest <= UINT32_MAX ? 2 : 3;
+}
+
+static void _write_fixed (uint8_t * at, unsigned width, uint64_t value)
+{
+    uint16_t u16 = value;
+    uint32_t u32 = value;
+
+    switch (width)
+    {
+    case 1: *at = value; break;
+    case 2: memcpy (at, &u16, 2); break;
+    case 4: memcpy (at, &u32, 4); break;
+    default: memcpy (at, &value, 8); break;
+    }
+}
+
+static uint64_t _read_fixed (const uint8_t * at, unsigned width)
+{
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+
+    switch (width)
+    {
+    case 1: return *at;
+    case 2: memcpy (&u16, at, 2); return u16;
+    case 4: memcpy (&u32, at, 4); return u32;
+    default: memcpy (&u64, at, 8); return u64;
+    }
+}
+
+static size_t _reserve_bytes (window_char * output, size_t size)
+{
+    size_t offset = range_count (output->region);
+
+    while (size--)
+    {
+	*window_push (*output) = 0;
+    }
+
+    return offset;
+}
+
+static int _compare_key (const char * a, size_t a_length, const char * b, size_t b_length)
+{
+    int compare = memcmp (a, b, a_length < b_length ? a_length : b_length);
+
+    if (compare)
+    {
+	return compare;
+    }
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+static int _compare_members (const void * a, const void * b)
+{
+    const json_compact_member * a_member = a;
+    const json_compact_member * b_member = b;
+
+    return _compare_key (a_member->key.begin, range_count (a_member->key), b_member->key.begin, range_count (b_member->key));
+}
+
+static range_const_char _pool_entry (const char * pool, size_t offset)
+{
+    const uint8_t * at = (const uint8_t*) pool + offset;
+    size_t length = _read_varint (&at);
+
+    return (range_const_char){ .begin = (const char*) at, .end = (const char*) at + length };
+}
+
+static uint64_t _hash_bytes (const range_const_char * bytes)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    const char * c;
+
+    for_range (c, *bytes)
+    {
+	hash = (hash ^ (uint8_t) *c) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+static bool _grow_slots (json_compact_builder * builder)
+{
+    size_t count = builder->slot_count ? builder->slot_count * 2 : JSON_COMPACT_INITIAL_SLOTS;
+    json_compact_slot * slots = calloc (count, sizeof(*slots));
+    size_t i;
+
+    if (!slots)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    for (size_t n = 0; n < builder->slot_count; n++)
+    {
+	if (!builder->slots[n].offset)
+	{
+	    continue;
+	}
+
+	for (i = builder->slots[n].hash & (count - 1); slots[i].offset; i = (i + 1) & (count - 1))
+	{
+	}
+
+	slots[i] = builder->slots[n];
+    }
+
+    free (builder->slots);
+    builder->slots = slots;
+    builder->slot_count = count;
+
+    return true;
+}
+
+static bool _intern (size_t * offset, json_compact_builder * builder, const range_const_char * string)
+{
+    uint64_t hash = _hash_bytes (string);
+    range_const_char entry;
+    json_compact_slot * slot;
+    const char * c;
+
+    if (builder->used * 2 >= builder->slot_count && !_grow_slots (builder))
+    {
+	return false;
+    }
+
+    for (size_t i = hash & (builder->slot_count - 1); ; i = (i + 1) & (builder->slot_count - 1))
+    {
+	slot = builder->slots + i;
+
+	if (!slot->offset)
+	{
+	    break;
+	}
+
+	if (slot->hash != hash)
+	{
+	    continue;
+	}
+
+	entry = _pool_entry (builder->pool.region.begin, slot->offset - 1);
+
+	if (0 == _compare_key (entry.begin, range_count (entry), string->begin, range_count (*string)))
+	{
+	    *offset = slot->offset - 1;
+	    return true;
+	}
+    }
+
+    *offset = range_count (builder->pool.region);
+
+    _write_varint (&builder->pool, range_count (*string));
+
+    for_range (c, *string)
+    {
+	*window_push (builder->pool) = *c;
+    }
+
+    // Terminated so json_compact_string can hand out the pool bytes directly
+    *window_push (builder->pool) = '\0';
+
+    *slot = (json_compact_slot){ .hash = hash, .offset = *offset + 1 };
+    builder->used++;
+
+    return true;
+}
+
+static bool _integral (int64_t * output, double number)
+{
+    if (!(-9223372036854775808.0 <= number && number < 9223372036854775808.0) || number != (double) (int64_t) number
+	|| (number == 0 && signbit (number)))
+    {
+	return false;
+    }
+
+    *output = (int64_t) number;
+
+    return true;
+}
+
+static bool _number_elements (const json_value * array)
+{
+    if (json_is_packed (array))
+    {
+	return true;
+    }
+
+    if (!array->count)
+    {
+	return false;
+    }
+
+    for (size_t i = 0; i < array->count; i++)
+    {
+	if (json_resolve (array->elements + i)->type != JSON_NUMBER)
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+static double _element_number (const json_value * array, size_t index)
+{
+    json_number_array numbers;
+
+    if (json_is_packed (array))
+    {
+	numbers = json_packed_numbers (array);
+	return json_number_at (&numbers, index);
+    }
+
+    return json_number (json_resolve (array->elements + index));
+}
+
+static bool _element_integer (int64_t * output, const json_value * array, size_t index)
+{
+    if (array->flags & JSON_FLAG_PACKED_INT64)
+    {
+	*output = array->integers[index];
+	return true;
+    }
+
+    return _integral (output, _element_number (array, index));
+}
+
+static void _encode_numbers (json_compact_builder * builder, const json_value * array)
+{
+    size_t count = array->count;
+    bool integral = true;
+    bool floats = true;
+    int64_t minimum = INT64_MAX;
+    int64_t maximum = INT64_MIN;
+    int64_t integer;
+    unsigned packed = json_is_packed (array) ? JSON_COMPACT_PACKED : 0;
+    unsigned code;
+    unsigned width;
+    size_t offset;
+    double number;
+    float single;
+
+    for (size_t i = 0; i < count && integral; i++)
+    {
+	if ((integral = _element_integer (&integer, array, i)))
+	{
+	    minimum = integer < minimum ? integer : minimum;
+	    maximum = integer > maximum ? integer : maximum;
+	}
+    }
+
+    if (integral)
+    {
+	code = _width_code ((uint64_t) maximum - (uint64_t) minimum);
+	width = 1u << code;
+
+	*window_push (builder->nodes) = (char) (JSON_COMPACT_INTEGERS | code << 4 | packed);
+	_write_varint (&builder->nodes, count);
+	_write_varint (&builder->nodes, _zigzag (minimum));
+	offset = _reserve_bytes (&builder->nodes, count * width);
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    _element_integer (&integer, array, i);
+	    _write_fixed ((uint8_t*) builder->nodes.region.begin + offset + i * width, width, (uint64_t) integer - (uint64_t) minimum);
+	}
+
+	return;
+    }
+
+    for (size_t i = 0; i < count && floats; i++)
+    {
+	number = _element_number (array, i);
+	floats = (double) (float) number == number;
+    }
+
+    *window_push (builder->nodes) = (char) ((floats ? JSON_COMPACT_FLOATS : JSON_COMPACT_DOUBLES) | packed);
+    _write_varint (&builder->nodes, count);
+    offset = _reserve_bytes (&builder->nodes, count * (floats ? sizeof(single) : sizeof(number)));
+
+    for (size_t i = 0; i < count; i++)
+    {
+	number = _element_number (array, i);
+	single = (float) number;
+
+	if (floats)
+	{
+	    memcpy (builder->nodes.region.begin + offset + i * sizeof(single), &single, sizeof(single));
+	}
+	else
+	{
+	    memcpy (builder->nodes.region.begin + offset + i * sizeof(number), &number, sizeof(number));
+	}
+    }
+}
+
+static bool _encode (json_compact_builder * builder, const json_value * value);
+
+static bool _encode_container (json_compact_builder * builder, const json_value * value)
+{
+    bool keys = value->type == JSON_OBJECT;
+    size_t start = range_count (builder->nodes.region);
+    size_t count = keys ? json_object_size (value) : value->count;
+    json_compact_member * members = NULL;
+    json_field_iterator fields;
+    size_t * offsets = malloc ((2 * count + 1) * sizeof(*offsets));
+    size_t largest_key = 0;
+    size_t header_size;
+    size_t body_size;
+    unsigned code;
+    unsigned key_code;
+    unsigned width;
+    unsigned key_width;
+    uint8_t * at;
+
+    if (!offsets)
+    {
+	perror ("malloc");
+	return false;
+    }
+
+    if (keys)
+    {
+	members = malloc ((count + 1) * sizeof(*members));
+
+	if (!members)
+	{
+	    perror ("malloc");
+	    goto fail;
+	}
+
+	fields = json_field_iterator (value);
+
+	for (size_t i = 0; json_field_next (&fields); i++)
+	{
+	    members[i] = (json_compact_member){ .key = fields.key, .value = fields.value };
+	}
+
+	qsort (members, count, sizeof(*members), _compare_members);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+	if (keys)
+	{
+	    if (!_intern (offsets + count + i, builder, &members[i].key))
+	    {
+		goto fail;
+	    }
+
+	    largest_key = offsets[count + i] > largest_key ? offsets[count + i] : largest_key;
+	}
+
+	offsets[i] = range_count (builder->nodes.region) - start;
+
+	if (!_encode (builder, keys ? members[i].value : value->elements + i))
+	{
+	    goto fail;
+	}
+    }
+
+    // Children were written first, the header is slid in front of them once their widths are known
+    body_size = range_count (builder->nodes.region) - start;
+    code = _width_code (count ? offsets[count - 1] : 0);
+    key_code = _width_code (largest_key);
+    width = 1u << code;
+    key_width = keys ? 1u << key_code : 0;
+    header_size = 1 + _varint_size (count) + count * (width + key_width);
+
+    _reserve_bytes (&builder->nodes, header_size);
+    at = (uint8_t*) builder->nodes.region.begin + start;
+    memmove (at + header_size, at, body_size);
+
+    *at++ = (keys ? JSON_COMPACT_OBJECT : JSON_COMPACT_ARRAY) | code << 4 | (keys ? key_code << 6 : 0);
+
+    at = _store_varint (at, count);
+
+    for (size_t i = 0; i < count && keys; i++)
+    {
+	_write_fixed (at, key_width, offsets[count + i]);
+	at += key_width;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+	_write_fixed (at, width, offsets[i]);
+	at += width;
+    }
+
+    free (members);
+    free (offsets);
+    return true;
+
+fail:
+    free (members);
+    free (offsets);
+    return false;
+}
+
+static bool _encode (json_compact_builder * builder, const json_value * value)
+{
+    size_t offset;
+    int64_t integer;
+    double number;
+
+    value = json_resolve (value);
+
+    switch (value->type)
+    {
+    case JSON_NULL:
+	*window_push (builder->nodes) = JSON_COMPACT_NULL;
+	return true;
+
+    case JSON_TRUE:
+	*window_push (builder->nodes) = JSON_COMPACT_TRUE;
+	return true;
+
+    case JSON_FALSE:
+	*window_push (builder->nodes) = JSON_COMPACT_FALSE;
+	return true;
+
+    case JSON_NUMBER:
+	number = json_number (value);
+
+	if (_integral (&integer, number))
+	{
+	    *window_push (builder->nodes) = JSON_COMPACT_INTEGER;
+	    _write_varint (&builder->nodes, _zigzag (integer));
+	}
+	else
+	{
+	    *window_push (builder->nodes) = JSON_COMPACT_DOUBLE;
+	    offset = _reserve_bytes (&builder->nodes, sizeof(number));
+	    memcpy (builder->nodes.region.begin + offset, &number, sizeof(number));
+	}
+	return true;
+
+    case JSON_STRING:
+	if (!_intern (&offset, builder, &(range_const_char){ .begin = value->string, .end = value->string + value->count }))
+	{
+	    return false;
+	}
+
+	*window_push (builder->nodes) = JSON_COMPACT_STRING;
+	_write_varint (&builder->nodes, offset);
+	return true;
+
+    case JSON_ARRAY:
+	if (_number_elements (value))
+	{
+	    _encode_numbers (builder, value);
+	    return true;
+	}
+
+	return _encode_container (builder, value);
+
+    case JSON_OBJECT:
+	return _encode_container (builder, value);
+
+    default:
+    case JSON_BADTYPE:
+	log_fatal ("Cannot compact a value of type %s", json_type_name (value->type));
+    }
+
+fail:
+    return false;
+}
+
+bool json_compact_build (json_compact * compact, const json_value * value)
+{
+    json_compact_builder builder = {0};
+    size_t nodes_size;
+    size_t pool_size;
+
+    *compact = (json_compact){0};
+
+    if (!_encode (&builder, value))
+    {
+	goto fail;
+    }
+
+    nodes_size = range_count (builder.nodes.region);
+    pool_size = range_count (builder.pool.region);
+
+    compact->bytes = malloc (nodes_size + pool_size + 1);
+
+    if (!compact->bytes)
+    {
+	perror ("malloc");
+	goto fail;
+    }
+
+    memcpy (compact->bytes, builder.nodes.region.begin, nodes_size);
+
+    if (pool_size)
+    {
+	memcpy (compact->bytes + nodes_size, builder.pool.region.begin, pool_size);
+    }
+
+    compact->size = nodes_size + pool_size;
+    compact->pool = nodes_size;
+
+    free (builder.nodes.alloc.begin);
+    free (builder.pool.alloc.begin);
+    free (builder.slots);
+    return true;
+
+fail:
+    free (builder.nodes.alloc.begin);
+    free (builder.pool.alloc.begin);
+    free (builder.slots);
+    return false;
+}
+
+void json_compact_clear (json_compact * compact)
+{
+    free (compact->bytes);
+    *compact = (json_compact){0};
+}
+
+static json_compact_container _container (const uint8_t * at)
+{
+    json_compact_container container = { .width = _width (*at), .key_width = _key_width (*at) };
+    bool keys = _kind (*at) == JSON_COMPACT_OBJECT;
+
+    at++;
+    container.count = _read_varint (&at);
+    container.keys = at;
+
+    if (keys)
+    {
+	at += container.count * container.key_width;
+    }
+
+    container.offsets = at;
+    container.body = at + container.count * container.width;
+
+    return container;
+}
+
+static json_compact_numbers _numbers (const uint8_t * at)
+{
+    json_compact_numbers numbers = { .kind = _kind (*at) };
+
+    numbers.width = numbers.kind == JSON_COMPACT_INTEGERS ? _width (*at) : numbers.kind == JSON_COMPACT_FLOATS ? sizeof(float) : sizeof(double);
+
+    at++;
+    numbers.count = _read_varint (&at);
+
+    if (numbers.kind == JSON_COMPACT_INTEGERS)
+    {
+	numbers.minimum = _unzigzag (_read_varint (&at));
+    }
+
+    numbers.data = at;
+
+    return numbers;
+}
+
+static int64_t _numbers_integer (const json_compact_numbers * numbers, size_t index)
+{
+    return (int64_t) ((uint64_t) numbers->minimum + _read_fixed (numbers->data + index * numbers->width, numbers->width));
+}
+
+static double _numbers_at (const json_compact_numbers * numbers, size_t index)
+{
+    float single;
+    double number;
+
+    if (numbers->kind == JSON_COMPACT_INTEGERS)
+    {
+	return (double) _numbers_integer (numbers, index);
+    }
+
+    if (numbers->kind == JSON_COMPACT_FLOATS)
+    {
+	memcpy (&single, numbers->data + index * sizeof(single), sizeof(single));
+	return single;
+    }
+
+    memcpy (&number, numbers->data + index * sizeof(number), sizeof(number));
+    return number;
+}
+
+static bool _is_numbers (unsigned kind)
+{
+    return kind == JSON_COMPACT_INTEGERS || kind == JSON_COMPACT_FLOATS || kind == JSON_COMPACT_DOUBLES;
+}
+
+json_compact_node json_compact_root (const json_compact * compact)
+{
+    return (json_compact_node){ .compact = compact, .at = compact->bytes };
+}
+
+json_type json_compact_type (json_compact_node node)
+{
+    if (!node.at)
+    {
+	return JSON_BADTYPE;
+    }
+
+    if (node.element)
+    {
+	return JSON_NUMBER;
+    }
+
+    switch (_kind (*node.at))
+    {
+    case JSON_COMPACT_NULL: return JSON_NULL;
+    case JSON_COMPACT_TRUE: return JSON_TRUE;
+    case JSON_COMPACT_FALSE: return JSON_FALSE;
+    case JSON_COMPACT_INTEGER: return JSON_NUMBER;
+    case JSON_COMPACT_DOUBLE: return JSON_NUMBER;
+    case JSON_COMPACT_STRING: return JSON_STRING;
+    case JSON_COMPACT_OBJECT: return JSON_OBJECT;
+    default: return JSON_ARRAY;
+    }
+}
+
+size_t json_compact_count (json_compact_node node)
+{
+    assert (json_compact_type (node) == JSON_ARRAY || json_compact_type (node) == JSON_OBJECT);
+
+    if (_is_numbers (_kind (*node.at)))
+    {
+	return _numbers (node.at).count;
+    }
+
+    return _container (node.at).count;
+}
+
+double json_compact_number (json_compact_node node)
+{
+    const uint8_t * at = node.at + 1;
+    json_compact_numbers numbers;
+    double number;
+
+    assert (json_compact_type (node) == JSON_NUMBER);
+
+    if (node.element)
+    {
+	numbers = _numbers (node.at);
+	return _numbers_at (&numbers, node.element - 1);
+    }
+
+    if (_kind (*node.at) == JSON_COMPACT_INTEGER)
+    {
+	return (double) _unzigzag (_read_varint (&at));
+    }
+
+    memcpy (&number, at, sizeof(number));
+    return number;
+}
+
+range_const_char json_compact_string_range (json_compact_node node)
+{
+    const uint8_t * at = node.at + 1;
+
+    assert (json_compact_type (node) == JSON_STRING);
+
+    return _pool_entry ((const char*) node.compact->bytes + node.compact->pool, _read_varint (&at));
+}
+
+const char * json_compact_string (json_compact_node node)
+{
+    return json_compact_string_range (node).begin;
+}
+
+json_compact_node json_compact_element (json_compact_node node, size_t index)
+{
+    json_compact_container container;
+
+    assert (index < json_compact_count (node));
+
+    if (_is_numbers (_kind (*node.at)))
+    {
+	return (json_compact_node){ .compact = node.compact, .at = node.at, .element = index + 1 };
+    }
+
+    container = _container (node.at);
+
+    return (json_compact_node){ .compact = node.compact, .at = container.body + _read_fixed (container.offsets + index * container.width, container.width) };
+}
+
+range_const_char json_compact_key (json_compact_node object, size_t index)
+{
+    json_compact_container container;
+
+    assert (json_compact_type (object) == JSON_OBJECT);
+
+    container = _container (object.at);
+
+    assert (index < container.count);
+
+    return _pool_entry ((const char*) object.compact->bytes + object.compact->pool, _read_fixed (container.keys + index * container.key_width, container.key_width));
+}
+
+json_compact_node json_compact_lookup (json_compact_node object, const char * key)
+{
+    json_compact_container container;
+    range_const_char candidate;
+    size_t key_length = strlen (key);
+    size_t low = 0;
+    size_t high;
+    size_t middle;
+    int compare;
+
+    assert (json_compact_type (object) == JSON_OBJECT);
+
+    container = _container (object.at);
+    high = container.count;
+
+    while (low < high)
+    {
+	middle = low + (high - low) / 2;
+	candidate = _pool_entry ((const char*) object.compact->bytes + object.compact->pool, _read_fixed (container.keys + middle * container.key_width, container.key_width));
+	compare = _compare_key (key, key_length, candidate.begin, range_count (candidate));
+
+	if (compare == 0)
+	{
+	    return (json_compact_node){ .compact = object.compact, .at = container.body + _read_fixed (container.offsets + middle * container.width, container.width) };
+	}
+	else if (compare < 0)
+	{
+	    high = middle;
+	}
+	else
+	{
+	    low = middle + 1;
+	}
+    }
+
+    return (json_compact_node){0};
+}
+
+static bool _decode_numbers (json_value * value, json_compact_node node)
+{
+    json_compact_numbers numbers = _numbers (node.at);
+
+    value->type = JSON_ARRAY;
+    value->doubles = malloc ((numbers.count + 1) * sizeof(*value->doubles));
+
+    if (!value->doubles)
+    {
+	perror ("malloc");
+	return false;
+    }
+
+    for (size_t i = 0; i < numbers.count; i++)
+    {
+	if (numbers.kind == JSON_COMPACT_INTEGERS)
+	{
+	    value->integers[i] = _numbers_integer (&numbers, i);
+	}
+	else
+	{
+	    value->doubles[i] = _numbers_at (&numbers, i);
+	}
+    }
+
+    value->flags = numbers.kind == JSON_COMPACT_INTEGERS ? JSON_FLAG_PACKED_INT64 : JSON_FLAG_PACKED_DOUBLE;
+    value->count = numbers.count;
+
+    return true;
+}
+
+bool json_compact_decode (json_value * value, json_compact_node node)
+{
+    json_type type = json_compact_type (node);
+    range_const_char string;
+    size_t count;
+    json_pair * pair;
+
+    *value = (json_value){ .type = type };
+
+    switch (type)
+    {
+    case JSON_NULL:
+    case JSON_TRUE:
+    case JSON_FALSE:
+	return true;
+
+    case JSON_NUMBER:
+	value->number = json_compact_number (node);
+	return true;
+
+    case JSON_STRING:
+	string = json_compact_string_range (node);
+	value->string = malloc (range_count (string) + 1);
+
+	if (!value->string)
+	{
+	    perror ("malloc");
+	    goto fail;
+	}
+
+	memcpy (value->string, string.begin, range_count (string) + 1);
+	value->count = range_count (string);
+	return true;
+
+    case JSON_ARRAY:
+	// Number arrays that were not packed in the source are rebuilt with an element per number
+	if (_is_numbers (_kind (*node.at)) && (*node.at & JSON_COMPACT_PACKED))
+	{
+	    if (!_decode_numbers (value, node))
+	    {
+		goto fail;
+	    }
+	    return true;
+	}
+
+	count = json_compact_count (node);
+	value->elements = calloc (count + 1, sizeof(*value->elements));
+
+	if (!value->elements)
+	{
+	    perror ("calloc");
+	    goto fail;
+	}
+
+	value->count = count;
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    if (!json_compact_decode (value->elements + i, json_compact_element (node, i)))
+	    {
+		json_value_clear (value);
+		goto fail;
+	    }
+	}
+	return true;
+
+    case JSON_OBJECT:
+	value->object = calloc (1, sizeof(*value->object));
+
+	if (!value->object)
+	{
+	    perror ("calloc");
+	    goto fail;
+	}
+
+	count = json_compact_count (node);
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    string = json_compact_key (node, i);
+	    pair = json_include_range (value->object, &string);
+
+	    if (!json_compact_decode (&pair->value, json_compact_element (node, i)))
+	    {
+		json_value_clear (value);
+		goto fail;
+	    }
+	}
+	return true;
+
+    default:
+	log_fatal ("Cannot decode a missing node");
+    }
+
+fail:
+    *value = (json_value){0};
+    return false;
+}
+
+keyargs_define(json_compact_get_bool)
+{
+    json_compact_node node = json_compact_lookup (args.parent, args.key);
+    json_type type = json_compact_type (node);
+
+    if (type == JSON_BADTYPE || type == JSON_NULL)
+    {
+	if (args.optional)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (type == JSON_TRUE)
+    {
+	return true;
+    }
+    else if (type == JSON_FALSE)
+    {
+	return false;
+    }
+    else
+    {
+	log_fatal ("Object child %s is not a boolean value", args.key);
+    }
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return false;
+}
+
+keyargs_define(json_compact_get_number)
+{
+    json_compact_node node = json_compact_lookup (args.parent, args.key);
+    json_type type = json_compact_type (node);
+
+    if (type == JSON_BADTYPE || type == JSON_NULL)
+    {
+	if (args.optional)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (type != JSON_NUMBER)
+    {
+	log_fatal ("Object child %s is not a number", args.key);
+    }
+
+    return json_compact_number (node);
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return 0;
+}
+
+keyargs_define(json_compact_get_string)
+{
+    json_compact_node node = json_compact_lookup (args.parent, args.key);
+    json_type type = json_compact_type (node);
+
+    if (type == JSON_BADTYPE || type == JSON_NULL)
+    {
+	if (args.optional && args.default_value)
+	{
+	    return args.default_value;
+	}
+
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (type != JSON_STRING)
+    {
+	log_fatal ("Object child %s is not a string", args.key);
+    }
+
+    return json_compact_string (node);
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return NULL;
+}
+
+keyargs_define(json_compact_get_array)
+{
+    json_compact_node node = json_compact_lookup (args.parent, args.key);
+    json_type type = json_compact_type (node);
+
+    if (type == JSON_BADTYPE || type == JSON_NULL)
+    {
+	if (!args.optional)
+	{
+	    log_fatal ("Object has no child %s", args.key);
+	}
+	else
+	{
+	    return (json_compact_node){0};
+	}
+    }
+
+    if (type != JSON_ARRAY)
+    {
+	log_fatal ("Object child %s is not an array", args.key);
+    }
+
+    return node;
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return (json_compact_node){0};
+}
+
+keyargs_define(json_compact_get_object)
+{
+    json_compact_node node = json_compact_lookup (args.parent, args.key);
+    json_type type = json_compact_type (node);
+
+    if (type == JSON_BADTYPE || type == JSON_NULL)
+    {
+	if (!args.optional)
+	{
+	    log_fatal ("Object has no child %s", args.key);
+	}
+	else
+	{
+	    return (json_compact_node){0};
+	}
+    }
+
+    if (type != JSON_OBJECT)
+    {
+	log_fatal ("Object child %s is not an object", args.key);
+    }
+
+    return node;
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return (json_compact_node){0};
+}
@@ -0,0 +1,97 @@
+#ifndef FLAT_INCLUDES
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#include "../keyargs/keyargs.h"
+#endif
+
+/*
+  A compact, read only form of a json_value tree for documents that stay
+  resident for a long time. The tree is encoded into a single buffer of
+  variable length nodes and a string pool:
+
+  - Every string, key or value, is stored once in the pool and nodes
+    refer to it by offset.
+  - Integers are zigzag varints and other numbers are 8 byte doubles.
+    Arrays of numbers are stored without per element nodes, either as a
+    minimum plus a fixed width delta per element, as floats when that
+    is lossless, or as doubles.
+  - Arrays and objects hold a table of offsets to their children, each
+    as narrow as the container allows, so elements are found without
+    decoding their siblings. Object members are sorted by key and found
+    with a binary search.
+
+  Nodes are decoded on access through json_compact_node handles, which
+  are small values that stay valid as long as the json_compact does.
+  A handle with a NULL at stands for a missing value. The elements of a
+  number array have handles of their own that point at the array.
+  json_compact_decode rebuilds an ordinary json_value from any node;
+  a number array comes back packed only when it was packed when built.
+*/
+
+typedef struct json_compact json_compact;
+struct json_compact {
+    uint8_t * bytes;
+    size_t size;
+    size_t pool;
+};
+
+typedef struct json_compact_node json_compact_node;
+struct json_compact_node {
+    const json_compact * compact;
+    const uint8_t * at;
+    size_t element;
+};
+
+bool json_compact_build (json_compact * compact, const json_value * value);
+void json_compact_clear (json_compact * compact);
+bool json_compact_decode (json_value * value, json_compact_node node);
+
+json_compact_node json_compact_root (const json_compact * compact);
+json_type json_compact_type (json_compact_node node);
+size_t json_compact_count (json_compact_node node);
+double json_compact_number (json_compact_node node);
+const char * json_compact_string (json_compact_node node);
+range_const_char json_compact_string_range (json_compact_node node);
+json_compact_node json_compact_element (json_compact_node node, size_t index);
+range_const_char json_compact_key (json_compact_node object, size_t index);
+json_compact_node json_compact_lookup (json_compact_node object, const char * key);
+
+#define json_compact_get_number(...) keyargs_call(json_compact_get_number, __VA_ARGS__)
+keyargs_declare(double, json_compact_get_number,
+		json_compact_node parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		double default_value;);
+
+#define json_compact_get_bool(...) keyargs_call(json_compact_get_bool, __VA_ARGS__)
+keyargs_declare(bool, json_compact_get_bool,
+		json_compact_node parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		bool default_value;);
+
+#define json_compact_get_string(...) keyargs_call(json_compact_get_string, __VA_ARGS__)
+keyargs_declare(const char*, json_compact_get_string,
+		json_compact_node parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		const char * default_value;);
+
+#define json_compact_get_array(...) keyargs_call(json_compact_get_array, __VA_ARGS__)
+keyargs_declare(json_compact_node, json_compact_get_array,
+		json_compact_node parent;
+		const char * key;
+		bool optional;
+		bool * success;);
+
+#define json_compact_get_object(...) keyargs_call(json_compact_get_object, __VA_ARGS__)
+keyargs_declare(json_compact_node, json_compact_get_object,
+		json_compact_node parent;
+		const char * key;
+		bool * success;
+		bool optional;);
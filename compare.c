@@ -0,0 +1,231 @@
+#include "compare.h"
+#include "traverse.h"
+
+#include <string.h>
+
+#define JSON_HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+static uint64_t _mix (uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t _hash_bytes (const char * bytes, size_t size)
+{
+    uint64_t h = size * JSON_HASH_MULTIPLIER;
+    uint64_t word;
+
+    while (size >= sizeof(word))
+    {
+	memcpy (&word, bytes, sizeof(word));
+	h = _mix (h ^ word) * JSON_HASH_MULTIPLIER;
+	bytes += sizeof(word);
+	size -= sizeof(word);
+    }
+
+    word = 0;
+    memcpy (&word, bytes, size);
+
+    return _mix (h ^ word);
+}
+
+static uint64_t _hash_number (double number)
+{
+    uint64_t bits;
+
+    if (number == 0)
+    {
+	number = 0;
+    }
+
+    memcpy (&bits, &number, sizeof(bits));
+
+    return _mix (bits);
+}
+
+static const json_value * _element (json_value * scratch, const json_value * array, size_t index)
+{
+    if (!json_is_packed (array))
+    {
+	return array->elements + index;
+    }
+
+    json_number_array numbers = json_packed_numbers (array);
+    
+    *scratch = (json_value){ .type = JSON_NUMBER, .number = json_number_at (&numbers, index) };
+
+    return scratch;
+}
+
+static uint64_t _hash (const json_value * value)
+{
+    const json_value * element;
+    json_value scratch;
+    json_field_iterator fields;
+    uint64_t h = _mix (value->type + 1);
+    uint64_t pair;
+
+    switch (value->type)
+    {
+    case JSON_NUMBER:
+	return h ^ _hash_number (json_number (value));
+
+    case JSON_STRING:
+	return h ^ _hash_bytes (value->string, value->count);
+
+    case JSON_ARRAY:
+	for (size_t i = 0; i < value->count; i++)
+	{
+	    element = _element (&scratch, value, i);
+	    h = _mix (h * JSON_HASH_MULTIPLIER + json_value_hash (element));
+	}
+	return h;
+
+    case JSON_OBJECT:
+	fields = json_field_iterator (value);
+
+	while (json_field_next (&fields))
+	{
+	    pair = _hash_bytes (fields.key.begin, range_count (fields.key));
+	    pair = _mix (pair * JSON_HASH_MULTIPLIER + json_value_hash (fields.value));
+	    h += pair;
+	}
+	return _mix (h);
+
+    default:
+	return h;
+    }
+}
+
+uint64_t json_value_hash (const json_value * value)
+{
+    uint64_t h;
+
+    if (value->type != JSON_SHARED)
+    {
+	return _hash (value);
+    }
+
+    h = atomic_load_explicit (&value->shared->hash, memory_order_relaxed);
+
+    if (h)
+    {
+	return h;
+    }
+
+    h = _hash (&value->shared->value);
+
+    if (!h)
+    {
+	h = 1;
+    }
+
+    atomic_store_explicit (&value->shared->hash, h, memory_order_relaxed);
+
+    return h;
+}
+
+static bool _cached_hashes_differ (const json_value * a, const json_value * b)
+{
+    if (a->type != JSON_SHARED || b->type != JSON_SHARED)
+    {
+	return false;
+    }
+
+    uint64_t a_hash = atomic_load_explicit (&a->shared->hash, memory_order_relaxed);
+    uint64_t b_hash = atomic_load_explicit (&b->shared->hash, memory_order_relaxed);
+
+    return a_hash && b_hash && a_hash != b_hash;
+}
+
+bool json_value_equal (const json_value * a, const json_value * b)
+{
+    json_value scratch_a;
+    json_value scratch_b;
+    json_field_iterator fields;
+    const json_value * other;
+
+    if (_cached_hashes_differ (a, b))
+    {
+	return false;
+    }
+
+    a = json_resolve (a);
+    b = json_resolve (b);
+
+    if (a == b)
+    {
+	return true;
+    }
+
+    if (a->type != b->type)
+    {
+	return false;
+    }
+
+    switch (a->type)
+    {
+    case JSON_NUMBER:
+	return json_number (a) == json_number (b);
+
+    case JSON_STRING:
+	return a->count == b->count && 0 == memcmp (a->string, b->string, a->count);
+
+    case JSON_ARRAY:
+	if (a->count != b->count)
+	{
+	    return false;
+	}
+
+	for (size_t i = 0; i < a->count; i++)
+	{
+	    if (!json_value_equal (_element (&scratch_a, a, i), _element (&scratch_b, b, i)))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    case JSON_OBJECT:
+	if ((a->flags & JSON_FLAG_SHAPED) && (b->flags & JSON_FLAG_SHAPED) && a->shaped->shape == b->shaped->shape)
+	{
+	    for (size_t i = 0; i < a->count; i++)
+	    {
+		if (!json_value_equal (a->shaped->values + i, b->shaped->values + i))
+		{
+		    return false;
+		}
+	    }
+
+	    return true;
+	}
+
+	if (json_object_size (a) != json_object_size (b))
+	{
+	    return false;
+	}
+
+	fields = json_field_iterator (a);
+
+	while (json_field_next (&fields))
+	{
+	    other = json_field (b, fields.key.begin);
+
+	    if (!other || !json_value_equal (fields.value, other))
+	    {
+		return false;
+	    }
+	}
+
+	return true;
+
+    default:
+	return true;
+    }
+}
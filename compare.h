@@ -0,0 +1,15 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stdint.h>
+#include "def.h"
+#endif
+
+/*
+  Structural hashing and equality. Objects compare as unordered sets of
+  keys, numbers compare by value so 0 and -0 are equal, and JSON_SHARED
+  handles compare by what they refer to. The hash of a frozen subtree is
+  computed once and cached in its box.
+*/
+
+uint64_t json_value_hash (const json_value * value);
+bool json_value_equal (const json_value * a, const json_value * b);
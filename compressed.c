@@ -0,0 +1,569 @@
+#include "compressed.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+_Static_assert ((JSON_PIPE_BUFFER_COUNT & (JSON_PIPE_BUFFER_COUNT - 1)) == 0, "JSON_PIPE_BUFFER_COUNT should be a power of two");
+
+typedef struct json_pipe_buffer json_pipe_buffer;
+struct json_pipe_buffer {
+    size_t size;
+    char bytes[JSON_PIPE_BUFFER_SIZE];
+};
+
+// Single producer, single consumer ring. head and tail only ever increase and are compared modulo the capacity.
+// A side that finds the ring full or empty spins briefly, then sleeps on changed until the other side moves.
+typedef struct json_pipe_ring json_pipe_ring;
+struct json_pipe_ring {
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_int waiting;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    json_pipe_buffer * slots[JSON_PIPE_BUFFER_COUNT];
+};
+
+typedef struct json_pipe json_pipe;
+struct json_pipe {
+    int fd;
+    const char * path;
+    atomic_bool stop;
+    bool failed;
+    json_pipe_ring full;
+    json_pipe_ring free;
+    json_pipe_buffer buffers[JSON_PIPE_BUFFER_COUNT];
+    char input[JSON_PIPE_BUFFER_SIZE];
+};
+
+typedef bool (*json_pipe_use) (void * arg, const range_const_char * chunk);
+
+#define JSON_PIPE_SPIN 64
+
+static bool _ring_init (json_pipe_ring * ring)
+{
+    if (0 != pthread_mutex_init (&ring->lock, NULL))
+    {
+	return false;
+    }
+
+    if (0 != pthread_cond_init (&ring->changed, NULL))
+    {
+	pthread_mutex_destroy (&ring->lock);
+	return false;
+    }
+
+    return true;
+}
+
+static void _ring_destroy (json_pipe_ring * ring)
+{
+    pthread_cond_destroy (&ring->changed);
+    pthread_mutex_destroy (&ring->lock);
+}
+
+static bool _ring_is_full (json_pipe_ring * ring, size_t tail)
+{
+    return tail - atomic_load (&ring->head) == JSON_PIPE_BUFFER_COUNT;
+}
+
+static bool _ring_is_empty (json_pipe_ring * ring, size_t head)
+{
+    return head == atomic_load (&ring->tail);
+}
+
+static bool _stopped (const atomic_bool * stop)
+{
+    return stop && atomic_load (stop);
+}
+
+static void _ring_wake (json_pipe_ring * ring)
+{
+    // Pairs with the waiter counting itself before its last check, so either it sees the move or we see it
+    if (atomic_load (&ring->waiting))
+    {
+	pthread_mutex_lock (&ring->lock);
+	pthread_cond_broadcast (&ring->changed);
+	pthread_mutex_unlock (&ring->lock);
+    }
+}
+
+static void _ring_wait (json_pipe_ring * ring, bool (*blocked) (json_pipe_ring * ring, size_t at), size_t at, const atomic_bool * stop)
+{
+    for (int spin = 0; spin < JSON_PIPE_SPIN; spin++)
+    {
+	if (!blocked (ring, at) || _stopped (stop))
+	{
+	    return;
+	}
+
+	sched_yield ();
+    }
+
+    pthread_mutex_lock (&ring->lock);
+    atomic_fetch_add (&ring->waiting, 1);
+
+    while (blocked (ring, at) && !_stopped (stop))
+    {
+	pthread_cond_wait (&ring->changed, &ring->lock);
+    }
+
+    atomic_fetch_sub (&ring->waiting, 1);
+    pthread_mutex_unlock (&ring->lock);
+}
+
+static void _ring_push (json_pipe_ring * ring, json_pipe_buffer * buffer)
+{
+    size_t tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+
+    // Rarely waits: there are exactly as many buffers as slots
+    _ring_wait (ring, _ring_is_full, tail, NULL);
+
+    ring->slots[tail % JSON_PIPE_BUFFER_COUNT] = buffer;
+    atomic_store (&ring->tail, tail + 1);
+    _ring_wake (ring);
+}
+
+static json_pipe_buffer * _ring_pop (json_pipe_ring * ring, const atomic_bool * stop)
+{
+    size_t head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+    json_pipe_buffer * buffer;
+
+    _ring_wait (ring, _ring_is_empty, head, stop);
+
+    if (_ring_is_empty (ring, head))
+    {
+	return NULL;
+    }
+
+    buffer = ring->slots[head % JSON_PIPE_BUFFER_COUNT];
+    atomic_store (&ring->head, head + 1);
+    _ring_wake (ring);
+
+    return buffer;
+}
+
+static json_pipe_buffer * _take (json_pipe * pipeline)
+{
+    json_pipe_buffer * buffer = _ring_pop (&pipeline->free, &pipeline->stop);
+
+    if (buffer)
+    {
+	buffer->size = 0;
+    }
+
+    return buffer;
+}
+
+static void _send (json_pipe * pipeline, json_pipe_buffer * buffer)
+{
+    if (buffer->size)
+    {
+	_ring_push (&pipeline->full, buffer);
+    }
+    else
+    {
+	_ring_push (&pipeline->free, buffer);
+    }
+}
+
+static ssize_t _read (json_pipe * pipeline, char * bytes, size_t size)
+{
+    ssize_t got = read (pipeline->fd, bytes, size);
+
+    if (got < 0)
+    {
+	perror (pipeline->path);
+    }
+
+    return got;
+}
+
+static bool _copy (json_pipe * pipeline, size_t have)
+{
+    json_pipe_buffer * buffer = _take (pipeline);
+    ssize_t got;
+
+    if (!buffer)
+    {
+	return true;
+    }
+
+    memcpy (buffer->bytes, pipeline->input, have);
+    buffer->size = have;
+
+    while (true)
+    {
+	if (buffer->size == JSON_PIPE_BUFFER_SIZE)
+	{
+	    _send (pipeline, buffer);
+
+	    if (!(buffer = _take (pipeline)))
+	    {
+		return true;
+	    }
+	}
+
+	got = _read (pipeline, buffer->bytes + buffer->size, JSON_PIPE_BUFFER_SIZE - buffer->size);
+
+	if (got < 0)
+	{
+	    _send (pipeline, buffer);
+	    return false;
+	}
+
+	if (got == 0)
+	{
+	    break;
+	}
+
+	buffer->size += got;
+    }
+
+    _send (pipeline, buffer);
+
+    return true;
+}
+
+static bool _inflate (json_pipe * pipeline, size_t have)
+{
+    z_stream stream = { .next_in = (Bytef*) pipeline->input, .avail_in = have };
+    json_pipe_buffer * buffer = NULL;
+    bool ended = false;
+    ssize_t got;
+    int status;
+
+    // 32 enables detection of gzip and zlib headers
+    if (Z_OK != inflateInit2 (&stream, 15 + 32))
+    {
+	log_fatal ("%s: could not initialize zlib", pipeline->path);
+    }
+
+    if (!(buffer = _take (pipeline)))
+    {
+	goto done;
+    }
+
+    while (true)
+    {
+	if (!stream.avail_in)
+	{
+	    if ((got = _read (pipeline, pipeline->input, sizeof(pipeline->input))) < 0)
+	    {
+		goto fail;
+	    }
+
+	    if (got == 0)
+	    {
+		break;
+	    }
+
+	    stream.next_in = (Bytef*) pipeline->input;
+	    stream.avail_in = got;
+	}
+
+	stream.next_out = (Bytef*) buffer->bytes + buffer->size;
+	stream.avail_out = JSON_PIPE_BUFFER_SIZE - buffer->size;
+
+	status = inflate (&stream, Z_NO_FLUSH);
+
+	if (status != Z_OK && status != Z_STREAM_END)
+	{
+	    log_fatal ("%s: %s", pipeline->path, stream.msg ? stream.msg : "invalid compressed data");
+	}
+
+	buffer->size = JSON_PIPE_BUFFER_SIZE - stream.avail_out;
+	ended = status == Z_STREAM_END;
+
+	if (ended)
+	{
+	    // Concatenated gzip members decompress as one stream
+	    inflateReset (&stream);
+	}
+
+	if (buffer->size == JSON_PIPE_BUFFER_SIZE)
+	{
+	    _send (pipeline, buffer);
+
+	    if (!(buffer = _take (pipeline)))
+	    {
+		goto done;
+	    }
+	}
+    }
+
+    if (!ended)
+    {
+	log_fatal ("%s: compressed data is truncated", pipeline->path);
+    }
+
+    _send (pipeline, buffer);
+
+done:
+    inflateEnd (&stream);
+    return true;
+
+fail:
+    if (buffer)
+    {
+	_send (pipeline, buffer);
+    }
+    inflateEnd (&stream);
+    return false;
+}
+
+static bool _decompress_zstd (json_pipe * pipeline, size_t have)
+{
+    ZSTD_DStream * stream = ZSTD_createDStream ();
+    ZSTD_inBuffer input = { .src = pipeline->input, .size = have };
+    ZSTD_outBuffer output;
+    json_pipe_buffer * buffer = NULL;
+    size_t status = 0;
+    ssize_t got;
+
+    if (!stream || ZSTD_isError (ZSTD_initDStream (stream)))
+    {
+	log_fatal ("%s: could not initialize zstd", pipeline->path);
+    }
+
+    if (!(buffer = _take (pipeline)))
+    {
+	goto done;
+    }
+
+    while (true)
+    {
+	if (input.pos == input.size)
+	{
+	    if ((got = _read (pipeline, pipeline->input, sizeof(pipeline->input))) < 0)
+	    {
+		goto fail;
+	    }
+
+	    if (got == 0)
+	    {
+		break;
+	    }
+
+	    input.size = got;
+	    input.pos = 0;
+	}
+
+	output = (ZSTD_outBuffer){ .dst = buffer->bytes, .size = JSON_PIPE_BUFFER_SIZE, .pos = buffer->size };
+
+	status = ZSTD_decompressStream (stream, &output, &input);
+
+	if (ZSTD_isError (status))
+	{
+	    log_fatal ("%s: %s", pipeline->path, ZSTD_getErrorName (status));
+	}
+
+	buffer->size = output.pos;
+
+	if (buffer->size == JSON_PIPE_BUFFER_SIZE)
+	{
+	    _send (pipeline, buffer);
+
+	    if (!(buffer = _take (pipeline)))
+	    {
+		goto done;
+	    }
+	}
+    }
+
+    if (status != 0)
+    {
+	log_fatal ("%s: compressed data is truncated", pipeline->path);
+    }
+
+    _send (pipeline, buffer);
+
+done:
+    ZSTD_freeDStream (stream);
+    return true;
+
+fail:
+    if (buffer)
+    {
+	_send (pipeline, buffer);
+    }
+    ZSTD_freeDStream (stream);
+    return false;
+}
+
+static void * _decompress_thread (void * arg)
+{
+    json_pipe * pipeline = arg;
+    const unsigned char * magic = (const unsigned char*) pipeline->input;
+    size_t have = 0;
+    ssize_t got;
+
+    while (have < 4)
+    {
+	if ((got = _read (pipeline, pipeline->input + have, 4 - have)) < 0)
+	{
+	    pipeline->failed = true;
+	    goto done;
+	}
+
+	if (got == 0)
+	{
+	    break;
+	}
+
+	have += got;
+    }
+
+    if (have >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+	pipeline->failed = !_inflate (pipeline, have);
+    }
+    else if (have == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    {
+	pipeline->failed = !_decompress_zstd (pipeline, have);
+    }
+    else
+    {
+	pipeline->failed = !_copy (pipeline, have);
+    }
+
+done:
+    // A NULL buffer marks the end of the input
+    _ring_push (&pipeline->full, NULL);
+    return NULL;
+}
+
+static bool _run (const char * path, json_pipe_use use, void * arg)
+{
+    json_pipe * pipeline = calloc (1, sizeof(*pipeline));
+    json_pipe_buffer * buffer;
+    pthread_t thread;
+    bool success = true;
+
+    if (!pipeline)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    pipeline->path = path;
+    pipeline->fd = open (path, O_RDONLY);
+
+    if (pipeline->fd < 0)
+    {
+	perror (path);
+	free (pipeline);
+	return false;
+    }
+
+    if (!_ring_init (&pipeline->full))
+    {
+	perror ("pthread_mutex_init");
+	close (pipeline->fd);
+	free (pipeline);
+	return false;
+    }
+
+    if (!_ring_init (&pipeline->free))
+    {
+	perror ("pthread_mutex_init");
+	_ring_destroy (&pipeline->full);
+	close (pipeline->fd);
+	free (pipeline);
+	return false;
+    }
+
+    for (int i = 0; i < JSON_PIPE_BUFFER_COUNT; i++)
+    {
+	_ring_push (&pipeline->free, pipeline->buffers + i);
+    }
+
+    if (0 != pthread_create (&thread, NULL, _decompress_thread, pipeline))
+    {
+	perror ("pthread_create");
+	_ring_destroy (&pipeline->full);
+	_ring_destroy (&pipeline->free);
+	close (pipeline->fd);
+	free (pipeline);
+	return false;
+    }
+
+    while ((buffer = _ring_pop (&pipeline->full, NULL)))
+    {
+	if (success && !use (arg, &(range_const_char){ .begin = buffer->bytes, .end = buffer->bytes + buffer->size }))
+	{
+	    // Let the decompressor give up at its next buffer; keep draining until it does
+	    success = false;
+	    atomic_store (&pipeline->stop, true);
+	    _ring_wake (&pipeline->free);
+	}
+
+	_ring_push (&pipeline->free, buffer);
+    }
+
+    pthread_join (thread, NULL);
+
+    success = success && !pipeline->failed;
+
+    _ring_destroy (&pipeline->full);
+    _ring_destroy (&pipeline->free);
+    close (pipeline->fd);
+    free (pipeline);
+
+    return success;
+}
+
+static bool _feed_stream (void * arg, const range_const_char * chunk)
+{
+    return json_stream_feed (arg, chunk);
+}
+
+bool json_stream_compressed_file (json_stream * stream, const char * path)
+{
+    return _run (path, _feed_stream, stream) && json_stream_finish (stream);
+}
+
+static bool _collect (void * arg, const range_const_char * chunk)
+{
+    window_char * text = arg;
+    const char * i;
+
+    for_range (i, *chunk)
+    {
+	*window_push (*text) = *i;
+    }
+
+    return true;
+}
+
+json_value * json_parse_compressed_file (json_parser_context * context, const char * path)
+{
+    window_char text = {0};
+    json_value * value = NULL;
+    bool lazy_numbers = context->lazy_numbers;
+
+    if (_run (path, _collect, &text))
+    {
+	// A trailing byte lets a literal end the document
+	*window_push (text) = '\n';
+
+	context->lazy_numbers = false;
+	value = json_parse_with (context, &text.region.alias_const);
+	context->lazy_numbers = lazy_numbers;
+    }
+
+    free (text.alloc.begin);
+
+    return value;
+}
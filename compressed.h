@@ -0,0 +1,29 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include "def.h"
+#include "parse.h"
+#include "stream.h"
+#endif
+
+/*
+  Pipelined parsing of compressed files. A background thread reads the
+  file, decompresses it according to its magic bytes (gzip, zlib or
+  zstd, otherwise it is passed through unchanged) and fills fixed size
+  buffers, which are handed to the calling thread through a bounded
+  single producer, single consumer lock free queue and returned through
+  a second one once parsed. Decompression of one buffer overlaps with
+  parsing of the previous ones, and only JSON_PIPE_BUFFER_COUNT
+  buffers of decompressed text exist at once.
+
+  json_stream_compressed_file feeds the decompressed text to a
+  json_stream (see stream.h) and finishes it. json_parse_compressed_file
+  reads a single document, which has to be collected whole before it is
+  parsed; lazy numbers are turned off for it since the text does not
+  outlive the call.
+*/
+
+#define JSON_PIPE_BUFFER_SIZE (1 << 16)
+#define JSON_PIPE_BUFFER_COUNT 8
+
+bool json_stream_compressed_file (json_stream * stream, const char * path);
+json_value * json_parse_compressed_file (json_parser_context * context, const char * path);
@@ -0,0 +1,448 @@
+#include "config.h"
+#include "parse.h"
+#include "shared.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "../log/log.h"
+
+#define JSON_CONFIG_RECLAIM_INTERVAL 50
+
+typedef struct json_config_retired json_config_retired;
+struct json_config_retired {
+    json_config_retired * next;
+    json_value * value;
+    uint64_t epoch;
+};
+
+struct json_config_reader {
+    json_config_reader * next;
+    json_config * config;
+    atomic_uint_least64_t epoch;
+};
+
+struct json_config {
+    char * path;
+    const char * name;
+    _Atomic(json_value *) current;
+    atomic_uint_least64_t epoch;
+    pthread_mutex_t readers_lock;
+    json_config_reader * readers;
+    json_config_retired * retired;
+    json_parser_context context;
+    int inotify;
+    int stop[2];
+    pthread_t thread;
+};
+
+static json_value * _load (json_config * config)
+{
+    range_const_char text;
+    range_const_char rest;
+    char * buffer = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    ssize_t got;
+    json_value * value = NULL;
+
+    int fd = open (config->path, O_RDONLY);
+
+    if (fd < 0)
+    {
+	perror (config->path);
+	return NULL;
+    }
+
+    while (true)
+    {
+	if (capacity - size < 4096)
+	{
+	    capacity = capacity * 2 + 4096;
+
+	    char * grow = realloc (buffer, capacity);
+
+	    if (!grow)
+	    {
+		perror ("realloc");
+		goto done;
+	    }
+
+	    buffer = grow;
+	}
+
+	got = read (fd, buffer + size, capacity - size);
+
+	if (got < 0)
+	{
+	    if (errno == EINTR)
+	    {
+		continue;
+	    }
+
+	    perror (config->path);
+	    goto done;
+	}
+
+	if (got == 0)
+	{
+	    break;
+	}
+
+	size += got;
+    }
+
+    buffer[size] = '\0';
+
+    text.begin = buffer;
+    text.end = buffer + size;
+    rest = text;
+
+    // The parser asserts on text that is not a value at all, so an empty or half written file is checked first
+    if (!json_skip_value (&config->context, &rest) || (json_scan_next (&rest), rest.begin != rest.end))
+    {
+	log_fatal ("Config %s is not a single JSON value", config->name);
+    }
+
+    value = json_parse_with (&config->context, &text);
+
+    if (value)
+    {
+	json_freeze (value);
+    }
+
+fail:
+done:
+    close (fd);
+    free (buffer);
+    return value;
+}
+
+static bool _reader_may_hold (json_config * config, uint64_t epoch)
+{
+    json_config_reader * reader;
+    uint64_t reader_epoch;
+    bool result = false;
+
+    pthread_mutex_lock (&config->readers_lock);
+
+    for (reader = config->readers; reader; reader = reader->next)
+    {
+	reader_epoch = atomic_load (&reader->epoch);
+
+	if (reader_epoch && reader_epoch < epoch)
+	{
+	    result = true;
+	    break;
+	}
+    }
+
+    pthread_mutex_unlock (&config->readers_lock);
+
+    return result;
+}
+
+static void _reclaim (json_config * config)
+{
+    json_config_retired ** i = &config->retired;
+    json_config_retired * retired;
+
+    while (*i)
+    {
+	retired = *i;
+
+	if (_reader_may_hold (config, retired->epoch))
+	{
+	    i = &retired->next;
+	    continue;
+	}
+
+	*i = retired->next;
+	json_value_free (retired->value);
+	free (retired);
+    }
+}
+
+static void _publish (json_config * config, json_value * value)
+{
+    json_config_retired * retired = malloc (sizeof(*retired));
+
+    if (!retired)
+    {
+	perror ("malloc");
+	json_value_free (value);
+	return;
+    }
+
+    retired->value = atomic_exchange (&config->current, value);
+    retired->epoch = atomic_fetch_add (&config->epoch, 1) + 1;
+    retired->next = config->retired;
+    config->retired = retired;
+}
+
+static bool _handle_events (json_config * config)
+{
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event * event;
+    bool changed = false;
+    ssize_t got;
+
+    got = read (config->inotify, buffer, sizeof(buffer));
+
+    if (got <= 0)
+    {
+	return false;
+    }
+
+    for (char * i = buffer; i < buffer + got; i += sizeof(*event) + event->len)
+    {
+	event = (const struct inotify_event*) i;
+
+	if (event->len && 0 == strcmp (event->name, config->name))
+	{
+	    changed = true;
+	}
+    }
+
+    return changed;
+}
+
+static void * _watch_thread (void * arg)
+{
+    json_config * config = arg;
+    json_value * value;
+    struct pollfd fds[2] = { { .fd = config->inotify, .events = POLLIN },
+			     { .fd = config->stop[0], .events = POLLIN } };
+
+    while (true)
+    {
+	if (0 > poll (fds, 2, config->retired ? JSON_CONFIG_RECLAIM_INTERVAL : -1))
+	{
+	    if (errno == EINTR)
+	    {
+		continue;
+	    }
+
+	    perror ("poll");
+	    break;
+	}
+
+	if (fds[1].revents)
+	{
+	    break;
+	}
+
+	if ((fds[0].revents & POLLIN) && _handle_events (config))
+	{
+	    value = _load (config);
+
+	    if (value)
+	    {
+		_publish (config, value);
+	    }
+	}
+
+	_reclaim (config);
+    }
+
+    return NULL;
+}
+
+json_config * json_config_watch (const char * path)
+{
+    char * directory;
+    char * slash;
+    json_value * value;
+
+    json_config * config = calloc (1, sizeof(*config));
+
+    if (!config)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    config->inotify = config->stop[0] = config->stop[1] = -1;
+
+    config->path = strdup (path);
+    directory = strdup (path);
+
+    if (!config->path || !directory)
+    {
+	perror ("strdup");
+	goto fail;
+    }
+
+    slash = strrchr (directory, '/');
+
+    if (slash)
+    {
+	config->name = config->path + (slash - directory) + 1;
+	slash[slash == directory ? 1 : 0] = '\0';
+    }
+    else
+    {
+	config->name = config->path;
+	strcpy (directory, ".");
+    }
+
+    atomic_init (&config->epoch, 1);
+    pthread_mutex_init (&config->readers_lock, NULL);
+
+    config->inotify = inotify_init1 (IN_CLOEXEC | IN_NONBLOCK);
+
+    if (config->inotify < 0)
+    {
+	perror ("inotify_init1");
+	goto fail;
+    }
+
+    if (0 > inotify_add_watch (config->inotify, directory, IN_CLOSE_WRITE | IN_MOVED_TO))
+    {
+	perror (directory);
+	goto fail;
+    }
+
+    if (0 != pipe (config->stop))
+    {
+	perror ("pipe");
+	goto fail;
+    }
+
+    value = _load (config);
+
+    if (!value)
+    {
+	log_fatal ("Could not load config %s", path);
+    }
+
+    atomic_init (&config->current, value);
+
+    if (0 != pthread_create (&config->thread, NULL, _watch_thread, config))
+    {
+	log_fatal ("Could not start the config watch thread");
+    }
+
+    free (directory);
+
+    return config;
+
+fail:
+    free (directory);
+
+    if (atomic_load (&config->current))
+    {
+	json_value_free (atomic_load (&config->current));
+    }
+
+    if (config->inotify >= 0)
+    {
+	close (config->inotify);
+    }
+
+    if (config->stop[0] >= 0)
+    {
+	close (config->stop[0]);
+	close (config->stop[1]);
+    }
+
+    json_parser_context_clear (&config->context);
+    free (config->path);
+    free (config);
+
+    return NULL;
+}
+
+void json_config_free (json_config * config)
+{
+    json_config_retired * retired;
+
+    if (1 != write (config->stop[1], "", 1))
+    {
+	perror ("write");
+    }
+
+    pthread_join (config->thread, NULL);
+
+    while ((retired = config->retired))
+    {
+	config->retired = retired->next;
+	json_value_free (retired->value);
+	free (retired);
+    }
+
+    json_value_free (atomic_load (&config->current));
+
+    close (config->inotify);
+    close (config->stop[0]);
+    close (config->stop[1]);
+
+    pthread_mutex_destroy (&config->readers_lock);
+    json_parser_context_clear (&config->context);
+    free (config->path);
+    free (config);
+}
+
+json_config_reader * json_config_reader_new (json_config * config)
+{
+    json_config_reader * reader = calloc (1, sizeof(*reader));
+
+    if (!reader)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    reader->config = config;
+    atomic_init (&reader->epoch, 0);
+
+    pthread_mutex_lock (&config->readers_lock);
+    reader->next = config->readers;
+    config->readers = reader;
+    pthread_mutex_unlock (&config->readers_lock);
+
+    return reader;
+}
+
+void json_config_reader_free (json_config_reader * reader)
+{
+    json_config * config = reader->config;
+    json_config_reader ** i;
+
+    pthread_mutex_lock (&config->readers_lock);
+
+    for (i = &config->readers; *i; i = &(*i)->next)
+    {
+	if (*i == reader)
+	{
+	    *i = reader->next;
+	    break;
+	}
+    }
+
+    pthread_mutex_unlock (&config->readers_lock);
+
+    free (reader);
+}
+
+const json_value * json_config_read_begin (json_config_reader * reader)
+{
+    atomic_store (&reader->epoch, atomic_load (&reader->config->epoch));
+
+    return json_resolve (atomic_load (&reader->config->current));
+}
+
+void json_config_read_end (json_config_reader * reader)
+{
+    atomic_store_explicit (&reader->epoch, 0, memory_order_release);
+}
@@ -0,0 +1,27 @@
+#ifndef FLAT_INCLUDES
+#include "def.h"
+#endif
+
+/*
+  json_config_watch loads a JSON file and re-parses it on a background
+  thread whenever it is rewritten or replaced. Each version is frozen
+  (see shared.h) and published with an atomic pointer swap.
+
+  Every thread that reads the configuration registers a reader. A
+  snapshot returned by json_config_read_begin stays valid until the
+  matching json_config_read_end. Replaced snapshots are freed by the
+  background thread once no reader that could have seen them is still
+  inside a read.
+*/
+
+typedef struct json_config json_config;
+typedef struct json_config_reader json_config_reader;
+
+json_config * json_config_watch (const char * path);
+void json_config_free (json_config * config);
+
+json_config_reader * json_config_reader_new (json_config * config);
+void json_config_reader_free (json_config_reader * reader);
+
+const json_value * json_config_read_begin (json_config_reader * reader);
+void json_config_read_end (json_config_reader * reader);
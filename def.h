@@ -1,4 +1,7 @@
 #ifndef FLAT_INCLUDES
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include "../table/string.h"
 #endif
 
@@ -14,25 +17,64 @@ typedef enum json_type {
     JSON_STRING,
     JSON_ARRAY,
     JSON_OBJECT,
+    JSON_SHARED,
     JSON_BADTYPE,
 }
     json_type;
 
 typedef struct json_value json_value;
+typedef struct json_shared json_shared;
+typedef struct json_shape json_shape;
+typedef struct json_shaped json_shaped;
+typedef struct json_number_box json_number_box;
 
 range_typedef(json_value, json_value);
 typedef range_json_value json_array;
 
+#define JSON_FLAG_NUMBER_TEXT 1
+#define JSON_FLAG_PACKED_DOUBLE 2
+#define JSON_FLAG_PACKED_INT64 4
+#define JSON_FLAG_SHAPED 8
+#define JSON_FLAG_NUMBER_BOXED 16
+
 struct json_value {
-    json_type type;
+    json_type type : 8;
+    unsigned int flags : 8;
+    uint32_t count;
     union {
 	double number;
+	const char * number_text;
 	char * string;
-	json_array array;
+	json_value * elements;
+	double * doubles;
+	int64_t * integers;
 	json_object * object;
+	json_shaped * shaped;
+	json_number_box * number_box;
+	json_shared * shared;
     };
 };
 
+// A lazy number that has been read once, along with its text
+struct json_number_box {
+    double number;
+    const char * text;
+};
+
+_Static_assert (sizeof(json_value) <= 16, "json_value should fit in 16 bytes");
+
+#define json_is_packed(input) ((input)->flags & (JSON_FLAG_PACKED_DOUBLE | JSON_FLAG_PACKED_INT64))
+#define json_elements(input) ((json_array){ .begin = (input)->elements, .end = (input)->elements + (input)->count })
+#define json_set_elements(output, range) ((output)->elements = (range).begin, (output)->count = range_count (range))
+
+struct json_shared {
+    atomic_size_t references;
+    atomic_uint_least64_t hash;
+    json_value value;
+};
+
+#define json_resolve(input) ((input)->type == JSON_SHARED ? &(input)->shared->value : (input))
+
 map_string_type_define(json);
 map_string_function_declare(json);
 #define json_object_clear json_table_clear
@@ -0,0 +1,462 @@
+#include "format.h"
+#include "parse.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+typedef struct format_state format_state;
+struct format_state {
+    const char * begin;
+    range_const_char input;
+    window_char * window;
+    char * cursor;
+    int indent;
+    size_t depth;
+    char stack[JSON_FORMAT_MAX_DEPTH];
+};
+
+static const char * _skip_whitespace (const char * i, const char * end)
+{
+#if defined(__AVX2__)
+    while (end - i >= 32)
+    {
+	__m256i bytes = _mm256_loadu_si256 ((const __m256i*) i);
+	__m256i space = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 (' ')),
+							  _mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 ('\n'))),
+					 _mm256_or_si256 (_mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 ('\r')),
+							  _mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 ('\t'))));
+	unsigned mask = ~(unsigned) _mm256_movemask_epi8 (space);
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    while (end - i >= 16)
+    {
+	__m128i bytes = _mm_loadu_si128 ((const __m128i*) i);
+	__m128i space = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (bytes, _mm_set1_epi8 (' ')),
+						    _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\n'))),
+				      _mm_or_si128 (_mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\r')),
+						    _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\t'))));
+	int mask = ~_mm_movemask_epi8 (space) & 0xffff;
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 16;
+    }
+#endif
+
+    while (i < end && (*i == ' ' || *i == '\n' || *i == '\r' || *i == '\t'))
+    {
+	i++;
+    }
+
+    return i;
+}
+
+// Finds the next quote, backslash or control character within a string
+static const char * _skip_string_bytes (const char * i, const char * end)
+{
+#if defined(__AVX2__)
+    while (end - i >= 32)
+    {
+	__m256i bytes = _mm256_loadu_si256 ((const __m256i*) i);
+	__m256i special = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 ('"')),
+							    _mm256_cmpeq_epi8 (bytes, _mm256_set1_epi8 ('\\'))),
+					   _mm256_cmpeq_epi8 (_mm256_min_epu8 (bytes, _mm256_set1_epi8 (0x1f)), bytes));
+	int mask = _mm256_movemask_epi8 (special);
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    while (end - i >= 16)
+    {
+	__m128i bytes = _mm_loadu_si128 ((const __m128i*) i);
+	__m128i special = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('"')),
+						      _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\\'))),
+					_mm_cmpeq_epi8 (_mm_min_epu8 (bytes, _mm_set1_epi8 (0x1f)), bytes));
+	int mask = _mm_movemask_epi8 (special);
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 16;
+    }
+#endif
+
+    while (i < end && *i != '"' && *i != '\\' && (unsigned char) *i >= 0x20)
+    {
+	i++;
+    }
+
+    return i;
+}
+
+static void _emit (format_state * state, const char * bytes, size_t size)
+{
+    const char * end = bytes + size;
+
+    if (state->window)
+    {
+	while (bytes < end)
+	{
+	    *window_push (*state->window) = *bytes++;
+	}
+    }
+    else
+    {
+	memmove (state->cursor, bytes, size);
+	state->cursor += size;
+    }
+}
+
+static void _emit_c (format_state * state, char c)
+{
+    _emit (state, &c, 1);
+}
+
+static void _newline (format_state * state)
+{
+    if (state->indent <= 0)
+    {
+	return;
+    }
+
+    *window_push (*state->window) = '\n';
+
+    for (size_t i = 0; i < state->depth * state->indent; i++)
+    {
+	*window_push (*state->window) = ' ';
+    }
+}
+
+static bool _next (format_state * state)
+{
+    state->input.begin = _skip_whitespace (state->input.begin, state->input.end);
+
+    return state->input.begin < state->input.end;
+}
+
+static size_t _offset (format_state * state)
+{
+    return (size_t) (state->input.begin - state->begin);
+}
+
+static bool _copy_string (format_state * state)
+{
+    const char * begin = state->input.begin;
+    const char * end = state->input.end;
+    const char * i = begin + 1;
+
+    assert (*begin == '"');
+
+    while (true)
+    {
+	i = _skip_string_bytes (i, end);
+
+	if (i == end)
+	{
+	    log_fatal ("Input ended within the string at byte %zu", _offset (state));
+	}
+
+	if (*i == '"')
+	{
+	    break;
+	}
+
+	if (*i != '\\')
+	{
+	    log_fatal ("Control character within the string at byte %zu", _offset (state));
+	}
+
+	if (end - i < 2)
+	{
+	    log_fatal ("Input ended within an escape at byte %zu", _offset (state));
+	}
+
+	switch (i[1])
+	{
+	case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+	    i += 2;
+	    break;
+
+	case 'u':
+	    if (end - i < 6 || !isxdigit ((unsigned char) i[2]) || !isxdigit ((unsigned char) i[3])
+		|| !isxdigit ((unsigned char) i[4]) || !isxdigit ((unsigned char) i[5]))
+	    {
+		log_fatal ("Invalid unicode escape at byte %zu", (size_t) (i - state->begin));
+	    }
+	    i += 6;
+	    break;
+
+	default:
+	    log_fatal ("Invalid escape at byte %zu", (size_t) (i - state->begin));
+	}
+    }
+
+    i++;
+
+    _emit (state, begin, i - begin);
+    state->input.begin = i;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _copy_literal (format_state * state, const char * literal)
+{
+    size_t size = strlen (literal);
+
+    if ((size_t) range_count (state->input) < size || 0 != memcmp (state->input.begin, literal, size))
+    {
+	log_fatal ("Invalid literal at byte %zu", _offset (state));
+    }
+
+    _emit (state, state->input.begin, size);
+    state->input.begin += size;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _transform (format_state * state)
+{
+    range_const_char number;
+    char c;
+
+value:
+    if (!_next (state))
+    {
+	log_fatal ("Input ended where a value was expected");
+    }
+
+    c = *state->input.begin;
+
+    switch (c)
+    {
+    case '{':
+    case '[':
+	if (state->depth == JSON_FORMAT_MAX_DEPTH)
+	{
+	    log_fatal ("Input nests deeper than %d levels at byte %zu", JSON_FORMAT_MAX_DEPTH, _offset (state));
+	}
+
+	state->input.begin++;
+	_emit_c (state, c);
+
+	if (_next (state) && *state->input.begin == (c == '{' ? '}' : ']'))
+	{
+	    _emit_c (state, *state->input.begin++);
+	    goto after_value;
+	}
+
+	state->stack[state->depth++] = c;
+	_newline (state);
+
+	if (c == '{')
+	{
+	    goto key;
+	}
+
+	goto value;
+
+    case '"':
+	if (!_copy_string (state))
+	{
+	    goto fail;
+	}
+	goto after_value;
+
+    case 't':
+	if (!_copy_literal (state, "true"))
+	{
+	    goto fail;
+	}
+	goto after_value;
+
+    case 'f':
+	if (!_copy_literal (state, "false"))
+	{
+	    goto fail;
+	}
+	goto after_value;
+
+    case 'n':
+	if (!_copy_literal (state, "null"))
+	{
+	    goto fail;
+	}
+	goto after_value;
+
+    default:
+	if (c != '-' && !('0' <= c && c <= '9'))
+	{
+	    log_fatal ("Unexpected '%c' at byte %zu", c, _offset (state));
+	}
+
+	if (!json_scan_number_text (&number, &state->input))
+	{
+	    goto fail;
+	}
+
+	_emit (state, number.begin, range_count (number));
+	goto after_value;
+    }
+
+key:
+    if (!_next (state) || *state->input.begin != '"')
+    {
+	log_fatal ("Expected a key at byte %zu", _offset (state));
+    }
+
+    if (!_copy_string (state))
+    {
+	goto fail;
+    }
+
+    if (!_next (state) || *state->input.begin != ':')
+    {
+	log_fatal ("Expected ':' at byte %zu", _offset (state));
+    }
+
+    state->input.begin++;
+    _emit_c (state, ':');
+
+    if (state->indent > 0)
+    {
+	_emit_c (state, ' ');
+    }
+
+    goto value;
+
+after_value:
+    if (!state->depth)
+    {
+	if (_next (state))
+	{
+	    log_fatal ("Unexpected input after the value at byte %zu", _offset (state));
+	}
+
+	return true;
+    }
+
+    if (!_next (state))
+    {
+	log_fatal ("Input ended within a container");
+    }
+
+    c = *state->input.begin;
+
+    if (c == ',')
+    {
+	state->input.begin++;
+	_emit_c (state, ',');
+	_newline (state);
+
+	if (state->stack[state->depth - 1] == '{')
+	{
+	    goto key;
+	}
+
+	goto value;
+    }
+
+    if (c == (state->stack[state->depth - 1] == '{' ? '}' : ']'))
+    {
+	state->input.begin++;
+	state->depth--;
+	_newline (state);
+	_emit_c (state, c);
+	goto after_value;
+    }
+
+    log_fatal ("Expected ',' or the end of a container at byte %zu", _offset (state));
+
+fail:
+    return false;
+}
+
+bool json_minify (window_char * output, const range_const_char * input)
+{
+    size_t base = range_count (output->region);
+    format_state state = { .begin = input->begin, .input = *input };
+
+    // Minified output is never longer than its input, so reserve that much and write through a cursor
+    for (long i = 0; i < range_count (*input); i++)
+    {
+	window_push (*output);
+    }
+
+    state.cursor = output->region.begin + base;
+
+    if (!_transform (&state))
+    {
+	output->region.end = output->region.begin + base;
+	return false;
+    }
+
+    output->region.end = state.cursor;
+
+    return true;
+}
+
+bool json_minify_in_place (range_char * text)
+{
+    format_state state = { .begin = text->begin, .input = text->alias_const, .cursor = text->begin };
+
+    if (!_transform (&state))
+    {
+	return false;
+    }
+
+    text->end = state.cursor;
+
+    return true;
+}
+
+bool json_reformat (window_char * output, const range_const_char * input, int indent)
+{
+    size_t base = range_count (output->region);
+    format_state state = { .begin = input->begin, .input = *input, .window = output, .indent = indent };
+
+    if (!_transform (&state))
+    {
+	output->region.end = output->region.begin + base;
+	return false;
+    }
+
+    return true;
+}
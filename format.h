@@ -0,0 +1,24 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include "../range/def.h"
+#include "../window/def.h"
+#endif
+
+/*
+  Byte level whitespace transforms. The input is checked against the
+  JSON grammar while it is copied, so invalid documents are refused,
+  but no json_values are built: strings and numbers are copied through
+  unchanged and only the whitespace between tokens is rewritten.
+
+  json_minify appends the input without insignificant whitespace to
+  output. json_minify_in_place does the same within text and moves its
+  end; on failure the contents of text are unspecified. json_reformat
+  appends the input with each member and element on its own line,
+  indented by indent spaces per level, or minified when indent is 0.
+*/
+
+#define JSON_FORMAT_MAX_DEPTH 1024
+
+bool json_minify (window_char * output, const range_const_char * input);
+bool json_minify_in_place (range_char * text);
+bool json_reformat (window_char * output, const range_const_char * input, int indent);
@@ -0,0 +1,434 @@
+#define _GNU_SOURCE
+#include "index.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+#define JSON_INDEX_BYTE_ORDER 0x01020304
+
+range_typedef(json_index_entry, json_index_entry);
+window_typedef(json_index_entry, json_index_entry);
+
+typedef struct json_index_builder json_index_builder;
+struct json_index_builder {
+    const char * begin;
+    json_parser_context context;
+    window_json_index_entry entries;
+    window_char pool;
+};
+
+static const char * _map (const char * path, size_t * size, struct stat * info)
+{
+    void * map;
+    int fd = open (path, O_RDONLY);
+
+    if (fd < 0)
+    {
+	perror (path);
+	return NULL;
+    }
+
+    if (0 != fstat (fd, info))
+    {
+	perror (path);
+	close (fd);
+	return NULL;
+    }
+
+    *size = info->st_size;
+
+    if (!*size)
+    {
+	close (fd);
+	log_fatal ("%s is empty", path);
+    }
+
+    map = mmap (NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close (fd);
+
+    if (map == MAP_FAILED)
+    {
+	perror ("mmap");
+	return NULL;
+    }
+
+    return map;
+
+fail:
+    return NULL;
+}
+
+static int _compare_keys (const void * a, const void * b, void * pool)
+{
+    return strcmp ((const char*) pool + ((const json_index_entry*) a)->key,
+		   (const char*) pool + ((const json_index_entry*) b)->key);
+}
+
+static bool _index_container (json_index_builder * builder, range_const_char * input, json_index_entry * parent, int depth)
+{
+    window_json_index_entry group = {0};
+    json_index_entry entry;
+    json_index_entry * i;
+    json_type type = json_scan_next (input);
+    bool keys = type == JSON_OBJECT;
+    char close = keys ? '}' : ']';
+    const char * c;
+
+    assert (type == JSON_OBJECT || type == JSON_ARRAY);
+
+    input->begin++;
+
+    if (!json_scan_punctuation (input, close))
+    {
+	while (true)
+	{
+	    entry = (json_index_entry){ .key = JSON_INDEX_NO_KEY };
+
+	    if (keys)
+	    {
+		if (!json_scan_string (&builder->context, input) || !json_scan_punctuation (input, ':'))
+		{
+		    log_fatal ("Expected a key and separator at byte %zu", (size_t) (input->begin - builder->begin));
+		}
+
+		if (memchr (builder->context.text.region.begin, '\0', range_count (builder->context.text.region)))
+		{
+		    log_fatal ("Key at byte %zu contains \\u0000", (size_t) (input->begin - builder->begin));
+		}
+
+		entry.key = range_count (builder->pool.region);
+
+		for_range (c, builder->context.text.region)
+		{
+		    *window_push (builder->pool) = *c;
+		}
+
+		*window_push (builder->pool) = '\0';
+	    }
+
+	    type = json_scan_next (input);
+	    entry.offset = input->begin - builder->begin;
+
+	    if (depth > 1 && (type == JSON_OBJECT || type == JSON_ARRAY))
+	    {
+		if (!_index_container (builder, input, &entry, depth - 1))
+		{
+		    goto fail;
+		}
+	    }
+	    else if (!json_skip_value (&builder->context, input))
+	    {
+		goto fail;
+	    }
+
+	    *window_push (group) = entry;
+
+	    if (json_scan_punctuation (input, close))
+	    {
+		break;
+	    }
+
+	    if (!json_scan_punctuation (input, ','))
+	    {
+		log_fatal ("Expected ',' or '%c' at byte %zu", close, (size_t) (input->begin - builder->begin));
+	    }
+	}
+    }
+
+    if (keys)
+    {
+	qsort_r (group.region.begin, range_count (group.region), sizeof(*group.region.begin), _compare_keys, builder->pool.region.begin);
+    }
+
+    // Children are written after their own children, so every group is contiguous
+    parent->first_child = range_count (builder->entries.region);
+    parent->child_count = range_count (group.region);
+
+    for_range (i, group.region)
+    {
+	*window_push (builder->entries) = *i;
+    }
+
+    free (group.alloc.begin);
+    return true;
+
+fail:
+    free (group.alloc.begin);
+    return false;
+}
+
+static bool _write (FILE * file, const void * bytes, size_t size, const char * path)
+{
+    if (size && size != fwrite (bytes, 1, size, file))
+    {
+	perror (path);
+	return false;
+    }
+
+    return true;
+}
+
+bool json_index_build (const char * source_path, const char * index_path, int depth)
+{
+    json_index_builder builder = {0};
+    json_index_header header = { .version = JSON_INDEX_VERSION, .byte_order = JSON_INDEX_BYTE_ORDER };
+    struct stat info;
+    size_t size;
+    FILE * file = NULL;
+    json_type type;
+
+    builder.begin = _map (source_path, &size, &info);
+
+    if (!builder.begin)
+    {
+	return false;
+    }
+
+    range_const_char input = { .begin = builder.begin, .end = builder.begin + size };
+
+    type = json_scan_next (&input);
+
+    if (type != JSON_ARRAY && type != JSON_OBJECT)
+    {
+	log_fatal ("%s does not hold an array or object", source_path);
+    }
+
+    header.root.offset = input.begin - builder.begin;
+    header.root.key = JSON_INDEX_NO_KEY;
+
+    if (!_index_container (&builder, &input, &header.root, depth < 1 ? 1 : depth))
+    {
+	goto fail;
+    }
+
+    if (json_scan_next (&input) != JSON_BADTYPE || input.begin != input.end)
+    {
+	log_fatal ("%s has more input after its top level value", source_path);
+    }
+
+    memcpy (header.magic, JSON_INDEX_MAGIC, sizeof(header.magic));
+    header.source_size = size;
+    header.source_mtime = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    header.entry_count = range_count (builder.entries.region);
+    header.size = sizeof(header) + header.entry_count * sizeof(json_index_entry) + range_count (builder.pool.region);
+
+    file = fopen (index_path, "wb");
+
+    if (!file)
+    {
+	perror (index_path);
+	goto fail;
+    }
+
+    if (!_write (file, &header, sizeof(header), index_path)
+	|| !_write (file, builder.entries.region.begin, header.entry_count * sizeof(json_index_entry), index_path)
+	|| !_write (file, builder.pool.region.begin, range_count (builder.pool.region), index_path))
+    {
+	goto fail;
+    }
+
+    if (0 != fclose (file))
+    {
+	file = NULL;
+	perror (index_path);
+	goto fail;
+    }
+
+    munmap ((void*) builder.begin, size);
+    free (builder.entries.alloc.begin);
+    free (builder.pool.alloc.begin);
+    json_parser_context_clear (&builder.context);
+
+    return true;
+
+fail:
+    if (file)
+    {
+	fclose (file);
+    }
+
+    munmap ((void*) builder.begin, size);
+    free (builder.entries.alloc.begin);
+    free (builder.pool.alloc.begin);
+    json_parser_context_clear (&builder.context);
+
+    return false;
+}
+
+#define _header(index) ((const json_index_header*) (index)->map)
+#define _entries(index) ((const json_index_entry*) ((index)->map + sizeof(json_index_header)))
+#define _pool(index) ((index)->map + sizeof(json_index_header) + _header(index)->entry_count * sizeof(json_index_entry))
+
+bool json_index_open (json_index * index, const char * source_path, const char * index_path)
+{
+    struct stat info;
+    struct stat source_info;
+    const json_index_header * header;
+
+    *index = (json_index){0};
+
+    index->map = _map (index_path, &index->map_size, &info);
+
+    if (!index->map)
+    {
+	return false;
+    }
+
+    header = _header (index);
+
+    if (index->map_size < sizeof(*header) || 0 != memcmp (header->magic, JSON_INDEX_MAGIC, sizeof(header->magic)))
+    {
+	log_fatal ("%s is not a json index", index_path);
+    }
+
+    if (header->version != JSON_INDEX_VERSION || header->byte_order != JSON_INDEX_BYTE_ORDER)
+    {
+	log_fatal ("%s was written by an incompatible version or host", index_path);
+    }
+
+    if (header->size != index->map_size)
+    {
+	log_fatal ("%s is truncated", index_path);
+    }
+
+    index->source = _map (source_path, &index->source_size, &source_info);
+
+    if (!index->source)
+    {
+	goto fail;
+    }
+
+    if (header->source_size != index->source_size || header->source_mtime != (int64_t) source_info.st_mtim.tv_sec * 1000000000 + source_info.st_mtim.tv_nsec)
+    {
+	log_fatal ("%s does not match %s, it should be rebuilt", index_path, source_path);
+    }
+
+    return true;
+
+fail:
+    json_index_close (index);
+    return false;
+}
+
+void json_index_close (json_index * index)
+{
+    if (index->map)
+    {
+	munmap ((void*) index->map, index->map_size);
+    }
+
+    if (index->source)
+    {
+	munmap ((void*) index->source, index->source_size);
+    }
+
+    *index = (json_index){0};
+}
+
+static const json_index_entry * _entry (const json_index * index, size_t position)
+{
+    if (position == JSON_INDEX_ROOT)
+    {
+	return &_header (index)->root;
+    }
+
+    assert (position < _header (index)->entry_count);
+
+    return _entries (index) + position;
+}
+
+size_t json_index_count (const json_index * index, size_t parent)
+{
+    return _entry (index, parent)->child_count;
+}
+
+bool json_index_child (size_t * position, const json_index * index, size_t parent, size_t i)
+{
+    const json_index_entry * entry = _entry (index, parent);
+
+    if (i >= entry->child_count)
+    {
+	return false;
+    }
+
+    *position = entry->first_child + i;
+
+    return true;
+}
+
+bool json_index_lookup (size_t * position, const json_index * index, size_t parent, const char * key)
+{
+    const json_index_entry * entry = _entry (index, parent);
+    const json_index_entry * children = _entries (index) + entry->first_child;
+    const char * pool = _pool (index);
+    size_t low = 0;
+    size_t high = entry->child_count;
+    size_t middle;
+    int compare;
+
+    if (!high || children->key == JSON_INDEX_NO_KEY)
+    {
+	return false;
+    }
+
+    while (low < high)
+    {
+	middle = low + (high - low) / 2;
+	compare = strcmp (key, pool + children[middle].key);
+
+	if (compare == 0)
+	{
+	    *position = entry->first_child + middle;
+	    return true;
+	}
+
+	if (compare < 0)
+	{
+	    high = middle;
+	}
+	else
+	{
+	    low = middle + 1;
+	}
+    }
+
+    return false;
+}
+
+const char * json_index_key (const json_index * index, size_t position)
+{
+    const json_index_entry * entry = _entry (index, position);
+
+    return entry->key == JSON_INDEX_NO_KEY ? NULL : _pool (index) + entry->key;
+}
+
+json_value * json_parse_at (json_parser_context * context, const json_index * index, size_t position)
+{
+    const json_index_entry * entry = _entry (index, position);
+    range_const_char input = { .begin = index->source + entry->offset, .end = index->source + index->source_size };
+    json_value * value = calloc (1, sizeof(*value));
+
+    if (!value)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    if (!json_read_value (value, context, &input))
+    {
+	json_value_free (value);
+	return NULL;
+    }
+
+    return value;
+}
@@ -0,0 +1,70 @@
+#ifndef FLAT_INCLUDES
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#include "parse.h"
+#endif
+
+/*
+  A sidecar index for random access into a large JSON file whose top
+  level value is an array or an object. The index records the byte
+  offset of each top level element or member, and optionally of their
+  children down to a chosen depth, so a single entry can be parsed out
+  of the mmap'd source without scanning what comes before it.
+
+  Entries are addressed by position. JSON_INDEX_ROOT stands for the top
+  level value; the children of an indexed container are found with
+  json_index_child or, for objects, json_index_lookup. Members of an
+  object are sorted by key so lookups are a binary search, which means
+  json_index_child walks objects in key order rather than document
+  order. Keys are stored decoded in a string pool in the index.
+
+  The index remembers the size and modification time of its source and
+  refuses to open against a source that has changed. Lazy number text
+  returned by json_parse_at points into the mapped source and is valid
+  until the index is closed.
+*/
+
+#define JSON_INDEX_MAGIC "jsonindx"
+#define JSON_INDEX_VERSION 1
+#define JSON_INDEX_ROOT SIZE_MAX
+#define JSON_INDEX_NO_KEY UINT64_MAX
+
+typedef struct json_index_entry json_index_entry;
+struct json_index_entry {
+    uint64_t offset;
+    uint64_t key;
+    uint64_t first_child;
+    uint64_t child_count;
+};
+
+typedef struct json_index_header json_index_header;
+struct json_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t entry_count;
+    json_index_entry root;
+};
+
+typedef struct json_index json_index;
+struct json_index {
+    const char * map;
+    size_t map_size;
+    const char * source;
+    size_t source_size;
+};
+
+bool json_index_build (const char * source_path, const char * index_path, int depth);
+bool json_index_open (json_index * index, const char * source_path, const char * index_path);
+void json_index_close (json_index * index);
+
+size_t json_index_count (const json_index * index, size_t parent);
+bool json_index_child (size_t * position, const json_index * index, size_t parent, size_t i);
+bool json_index_lookup (size_t * position, const json_index * index, size_t parent, const char * key);
+const char * json_index_key (const json_index * index, size_t position);
+json_value * json_parse_at (json_parser_context * context, const json_index * index, size_t position);
@@ -1,13 +1,16 @@
 #include "traverse.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
 #include "parse.h"
+#include "utf8.h"
 #include "../window/def.h"
 #include "../window/alloc.h"
 #include "../log/log.h"
@@ -34,24 +37,46 @@ void json_value_clear(json_value * value)
     {
 	free (value->string);
     }
-    else if (value->type == JSON_OBJECT)
+    else if (value->type == JSON_NUMBER && (value->flags & JSON_FLAG_NUMBER_BOXED))
+    {
+	free (value->number_box);
+    }
+    else if (value->type == JSON_OBJECT && (value->flags & JSON_FLAG_SHAPED))
+    {
+	json_shape_table * table = value->shaped->shape->table;
+
+	for (uint32_t i = 0; i < value->count; i++)
+	{
+	    json_value_clear (value->shaped->values + i);
+	}
+
+	free (value->shaped);
+	json_shape_table_release (table);
+    }
+    else if (value->type == JSON_OBJECT && value->object)
     {
 	json_object_clear (value->object);
 	free(value->object);
     }
+    else if (value->type == JSON_ARRAY && json_is_packed (value))
+    {
+	free (value->doubles);
+    }
     else if (value->type == JSON_ARRAY)
     {
-	json_array_clear(&value->array);
+	json_array array = json_elements (value);
+	json_array_clear(&array);
+    }
+    else if (value->type == JSON_SHARED)
+    {
+	if (1 == atomic_fetch_sub_explicit (&value->shared->references, 1, memory_order_acq_rel))
+	{
+	    json_value_clear (&value->shared->value);
+	    free (value->shared);
+	}
     }
 }
 
-window_typedef(json_value, json_value);
-
-typedef struct {
-    window_char text;
-}
-    json_tmp;
-
 static bool _skip_whitespace (range_const_char * text)
 {
     while (true)
@@ -127,6 +152,185 @@ static bool _read_number (double * output, range_const_char * text)
     return true;
 }
 
+static bool _read_hex (uint32_t * output, range_const_char * text)
+{
+    char c;
+
+    if (range_count (*text) < 4)
+    {
+	log_fatal ("file ended while reading a u-hex escape");
+    }
+
+    *output = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+	c = text->begin[i];
+	*output <<= 4;
+
+	if ('0' <= c && c <= '9')
+	{
+	    *output |= c - '0';
+	}
+	else if ('a' <= c && c <= 'f')
+	{
+	    *output |= c - 'a' + 10;
+	}
+	else if ('A' <= c && c <= 'F')
+	{
+	    *output |= c - 'A' + 10;
+	}
+	else
+	{
+	    log_fatal ("invalid u-hex escape in string: %.4s", text->begin);
+	}
+    }
+
+    text->begin += 4;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _read_u_escape (window_char * string, range_const_char * text)
+{
+    uint32_t point;
+    uint32_t low;
+
+    if (!_read_hex (&point, text))
+    {
+	return false;
+    }
+
+    if (0xdc00 <= point && point <= 0xdfff)
+    {
+	log_fatal ("unpaired low surrogate in string: \\u%04x", (unsigned) point);
+    }
+
+    if (0xd800 <= point && point <= 0xdbff)
+    {
+	if (range_count (*text) < 2 || text->begin[0] != '\\' || text->begin[1] != 'u')
+	{
+	    log_fatal ("unpaired high surrogate in string: \\u%04x", (unsigned) point);
+	}
+
+	text->begin += 2;
+
+	if (!_read_hex (&low, text))
+	{
+	    return false;
+	}
+
+	if (low < 0xdc00 || 0xdfff < low)
+	{
+	    log_fatal ("high surrogate \\u%04x is followed by \\u%04x", (unsigned) point, (unsigned) low);
+	}
+
+	point = 0x10000 + ((point - 0xd800) << 10) + (low - 0xdc00);
+    }
+
+    if (point < 0x80)
+    {
+	*window_push (*string) = (char) point;
+    }
+    else if (point < 0x800)
+    {
+	*window_push (*string) = (char) (0xc0 | (point >> 6));
+	*window_push (*string) = (char) (0x80 | (point & 0x3f));
+    }
+    else if (point < 0x10000)
+    {
+	*window_push (*string) = (char) (0xe0 | (point >> 12));
+	*window_push (*string) = (char) (0x80 | ((point >> 6) & 0x3f));
+	*window_push (*string) = (char) (0x80 | (point & 0x3f));
+    }
+    else
+    {
+	*window_push (*string) = (char) (0xf0 | (point >> 18));
+	*window_push (*string) = (char) (0x80 | ((point >> 12) & 0x3f));
+	*window_push (*string) = (char) (0x80 | ((point >> 6) & 0x3f));
+	*window_push (*string) = (char) (0x80 | (point & 0x3f));
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _scan_digits (range_const_char * text)
+{
+    const char * begin = text->begin;
+
+    while (text->begin < text->end && '0' <= *text->begin && *text->begin <= '9')
+    {
+	text->begin++;
+    }
+
+    return text->begin != begin;
+}
+
+static bool _scan_number (range_const_char * number, range_const_char * text)
+{
+    range_const_char scan = *text;
+
+    if (scan.begin < scan.end && *scan.begin == '-')
+    {
+	scan.begin++;
+    }
+
+    // A leading zero stands alone in the integer part
+    if (scan.begin + 1 < scan.end && scan.begin[0] == '0' && '0' <= scan.begin[1] && scan.begin[1] <= '9')
+    {
+	scan.begin++;
+	goto invalid;
+    }
+
+    if (!_scan_digits (&scan))
+    {
+	goto invalid;
+    }
+
+    if (scan.begin < scan.end && *scan.begin == '.')
+    {
+	scan.begin++;
+
+	if (!_scan_digits (&scan))
+	{
+	    goto invalid;
+	}
+    }
+
+    if (scan.begin < scan.end && (*scan.begin == 'e' || *scan.begin == 'E'))
+    {
+	scan.begin++;
+
+	if (scan.begin < scan.end && (*scan.begin == '+' || *scan.begin == '-'))
+	{
+	    scan.begin++;
+	}
+
+	if (!_scan_digits (&scan))
+	{
+	    goto invalid;
+	}
+    }
+
+    number->begin = text->begin;
+    number->end = scan.begin;
+    text->begin = scan.begin;
+
+    return true;
+
+invalid:
+    log_fatal ("Invalid number: %.*s", (int) (scan.begin < scan.end ? scan.begin - text->begin + 1 : scan.begin - text->begin), text->begin);
+
+fail:
+    return false;
+}
+
 static bool _read_string (window_char * string, range_const_char * text)
 {
     assert (*text->begin == '"');
@@ -140,12 +344,6 @@ static bool _read_string (window_char * string, range_const_char * text)
 
     while (text->begin < text->end)
     {
-	if (*text->begin == '\\')
-	{
-	    escape = true;
-	    goto next;
-	}
-
 	if (escape)
 	{
 	    escape = false;
@@ -185,12 +383,22 @@ static bool _read_string (window_char * string, range_const_char * text)
 		goto add_c;
 
 	    case 'u':
-		log_fatal ("u-hex characters are currently unsupported");
+		text->begin++;
+		if (!_read_u_escape (string, text))
+		{
+		    return false;
+		}
+		continue;
 
 	    default:
-		log_fatal ("unrecognized escape code in string (%c): %.*s", *text->begin, range_count(*text) - 1, text->begin);
+		log_fatal ("unrecognized escape code in string (%c): %.*s", *text->begin, (int) range_count(*text) - 1, text->begin);
 	    }
 	}
+	else if (*text->begin == '\\')
+	{
+	    escape = true;
+	    goto next;
+	}
 	else if (*text->begin == '"')
 	{
 	    *window_push (*string) = '\0';
@@ -211,16 +419,34 @@ static bool _read_string (window_char * string, range_const_char * text)
 	text->begin++;
     }
 
-fail:
     log_fatal ("file ended while reading string");
-    
+
+fail:
+    return false;
+}
+
+static bool _read_checked_string (window_char * string, range_const_char * text, json_parser_context * context)
+{
+    if (!_read_string (string, text))
+    {
+	return false;
+    }
+
+    if (context->validate_utf8 && !json_utf8_valid (&string->region.alias_const))
+    {
+	log_fatal ("string is not valid UTF-8: %s", string->region.begin);
+    }
+
+    return true;
+
+fail:
     return false;
 }
 
 static bool _skip_string (range_const_char * text, const char * string)
 {
     int len = strlen (string);
-    if (range_count (*text) < len + 1)
+    if (range_count (*text) < len)
     {
 	return false;
     }
@@ -235,11 +461,14 @@ static bool _skip_string (range_const_char * text, const char * string)
     return true;
 }
 
-static bool _read_array (json_array * array, range_const_char * input, json_tmp * tmp);
-static json_object * _read_object (range_const_char * input, json_tmp * tmp);
+static bool _read_array (json_value * array, range_const_char * input, json_parser_context * context);
+static json_object * _read_object (range_const_char * input, json_parser_context * context);
+static bool _read_shaped_object (json_value * object, range_const_char * input, json_parser_context * context);
 
-static bool _read_value (json_value * value, range_const_char * input, json_tmp * tmp)
+static bool _read_value (json_value * value, range_const_char * input, json_parser_context * context)
 {
+    range_const_char number_text;
+
     assert (value);
     
     *value = (json_value){0};
@@ -252,33 +481,53 @@ static bool _read_value (json_value * value, range_const_char * input, json_tmp
     switch (value->type)
     {
     case JSON_OBJECT:
-	value->object = _read_object (input, tmp);
+	if (context->share_shapes)
+	{
+	    return _read_shaped_object (value, input, context);
+	}
+	
+	value->object = _read_object (input, context);
 	return value->object != NULL;
 
     case JSON_STRING:
-	if (!_read_string(&tmp->text, input))
+	if (!_read_checked_string(&context->text, input, context))
 	{
 	    return false;
 	}
 
-	value->string = range_strdup_to_string (&tmp->text.region.alias_const);
+	if ((uint64_t) range_count (context->text.region) > UINT32_MAX)
+	{
+	    log_fatal ("String is longer than %u bytes", (unsigned) UINT32_MAX);
+	}
+
+	value->string = range_strdup_to_string (&context->text.region.alias_const);
 	
 	if (!value->string)
 	{
 	    perror ("malloc");
 	    return false;
 	}
+
+	value->count = range_count (context->text.region);
 	
 	return true;
 
     case JSON_ARRAY:
-	if (!_read_array (&value->array, input, tmp))
+	return _read_array (value, input, context);
+
+    case JSON_NUMBER:
+	if (context->lazy_numbers)
 	{
-	    return false;
+	    if (!_scan_number (&number_text, input))
+	    {
+		return false;
+	    }
+	    value->flags |= JSON_FLAG_NUMBER_TEXT;
+	    value->number_text = number_text.begin;
+	    value->count = range_count (number_text);
+	    return true;
 	}
-	return true;
 
-    case JSON_NUMBER:
 	if (!_read_number(&value->number, input))
 	{
 	    return false;
@@ -299,12 +548,100 @@ static bool _read_value (json_value * value, range_const_char * input, json_tmp
 	return false;
     }
 
+fail:
     return false;
 }
 
-static bool _read_array (json_array * array, range_const_char * input, json_tmp * tmp)
+static bool _integer_element (int64_t * output, const json_value * element)
+{
+    range_const_char text;
+    char buffer[32];
+    char * end;
+    double number;
+
+    if (json_number_text (&text, element))
+    {
+	if (range_count (text) >= (long) sizeof(buffer) || memchr (text.begin, '.', range_count (text))
+	    || memchr (text.begin, 'e', range_count (text)) || memchr (text.begin, 'E', range_count (text)))
+	{
+	    return false;
+	}
+
+	memcpy (buffer, text.begin, range_count (text));
+	buffer[range_count (text)] = '\0';
+
+	errno = 0;
+	*output = strtoll (buffer, &end, 10);
+
+	return errno == 0 && *end == '\0';
+    }
+
+    number = element->number;
+
+    if (!(-9223372036854775808.0 <= number && number < 9223372036854775808.0) || number != (double)(int64_t) number)
+    {
+	return false;
+    }
+
+    *output = (int64_t) number;
+
+    return true;
+}
+
+static bool _pack_numbers (json_value * array, const json_array * built)
+{
+    const json_value * i;
+    size_t count = range_count (*built);
+    bool integral = true;
+
+    for_range (i, *built)
+    {
+	if (i->type != JSON_NUMBER)
+	{
+	    return false;
+	}
+    }
+
+    array->integers = malloc (count * sizeof(*array->integers));
+
+    if (!array->integers)
+    {
+	perror ("malloc");
+	return false;
+    }
+
+    for (size_t n = 0; n < count && integral; n++)
+    {
+	integral = _integer_element (array->integers + n, built->begin + n);
+    }
+
+    if (integral)
+    {
+	array->flags |= JSON_FLAG_PACKED_INT64;
+    }
+    else
+    {
+	for (size_t n = 0; n < count; n++)
+	{
+	    array->doubles[n] = json_number (built->begin + n);
+	}
+
+	array->flags |= JSON_FLAG_PACKED_DOUBLE;
+    }
+
+    array->count = count;
+
+    return true;
+}
+
+static bool _read_array (json_value * array, range_const_char * input, json_parser_context * context)
 {
-    window_json_value build_array = {0};
+    size_t base = range_count (context->values.region);
+    json_value element;
+    json_array built;
+    json_array copy;
+    json_value * i;
+    
     assert (*input->begin == '[');
     input->begin++;
 
@@ -326,11 +663,13 @@ static bool _read_array (json_array * array, range_const_char * input, json_tmp
 	    }
 	}
 
-	if (!_read_value (window_push (build_array), input, tmp))
+	if (!_read_value (&element, input, context))
 	{
 	    log_fatal ("Failed to read a value in the array: %s", input->begin);
 	}
 
+	*window_push (context->values) = element;
+
 	passed_comma = false;
 
 	_skip_whitespace (input);
@@ -343,13 +682,41 @@ static bool _read_array (json_array * array, range_const_char * input, json_tmp
     }
 
 fail:
-    free (build_array.alloc.begin);
-    *array = (range_json_value){0};
+    for (i = context->values.region.begin + base; i < context->values.region.end; i++)
+    {
+	json_value_clear (i);
+    }
+    context->values.region.end = context->values.region.begin + base;
+    *array = (json_value){0};
     return false;
     
 success:
-    range_copy(*array, build_array.region);
-    free (build_array.alloc.begin);
+    built.begin = context->values.region.begin + base;
+    built.end = context->values.region.end;
+    if ((size_t) range_count (built) > UINT32_MAX)
+    {
+	log_fatal ("Array has more than %u elements", (unsigned) UINT32_MAX);
+    }
+    if (range_is_empty (built))
+    {
+	// The value stack may not be allocated yet, so there is nothing to copy from
+	array->elements = NULL;
+	array->count = 0;
+    }
+    else if (!context->pack_numbers || !_pack_numbers (array, &built))
+    {
+	range_copy(copy, built);
+	json_set_elements (array, copy);
+    }
+    else
+    {
+	// Packing read the numbers, which may have left lazy ones boxed
+	for_range (i, built)
+	{
+	    json_value_clear (i);
+	}
+    }
+    context->values.region.end = context->values.region.begin + base;
     input->begin++;
     return true;
 }
@@ -364,60 +731,63 @@ static void _free_object (json_object * object)
     free (object);
     }*/
 
-static json_object * _read_object (range_const_char * text, json_tmp * tmp)
+// Reads the members of an object up to its closing brace, with key_read set when the first key and its separator are already read into context->text
+static bool _read_members (json_object * object, range_const_char * text, json_parser_context * context, bool key_read)
 {
-    json_object * object = calloc (1, sizeof(*object));
-
-    //table_string_resize (object->map, 1031);
-	
-    assert (*text->begin == '{');
-
-    text->begin++;
-
     json_pair * set_pair;
 
     bool expect_pair = false;
 
     while (true)
     {
-	if (_identify_next (text) != JSON_STRING)
+	if (!key_read)
 	{
-	    if (*text->begin == '}')
+	    if (_identify_next (text) != JSON_STRING)
 	    {
-		if (expect_pair)
+		if (*text->begin == '}')
 		{
-		    goto fail;
+		    if (expect_pair)
+		    {
+			goto fail;
+		    }
+		    else
+		    {
+			goto success;
+		    }
 		}
 		else
 		{
-		    goto success;
+		    log_fatal ("Object key is type %s, it should be a string\n%s", json_type_name (_identify_next(text)), text->begin);
 		}
 	    }
-	    else
+	
+	    if (!_read_checked_string (&context->text, text, context))
 	    {
-		log_fatal ("Object key is type %s, it should be a string\n%s", json_type_name (_identify_next(text)), text->begin);
+		log_fatal ("JSON object key is not a string: %s", text->begin);
 	    }
-	}
-	
-	if (!_read_string (&tmp->text, text))
-	{
-	    log_fatal ("JSON object key is not a string: %s", text->begin);
-	}
 
-	_skip_whitespace (text);
+	    if (memchr (context->text.region.begin, '\0', range_count (context->text.region)))
+	    {
+		log_fatal ("JSON object key contains \\u0000");
+	    }
 
-	if (*text->begin != ':')
-	{
-	    log_fatal ("Pair separator is missing within JSON object: %s", text->begin);
+	    _skip_whitespace (text);
+
+	    if (*text->begin != ':')
+	    {
+		log_fatal ("Pair separator is missing within JSON object: %s", text->begin);
+	    }
+
+	    text->begin++;
 	}
 
-	text->begin++;
+	key_read = false;
         
-	set_pair = json_include_range(object, &tmp->text.region.alias_const);
+	set_pair = json_include_range(object, &context->text.region.alias_const);
 
 	assert ((size_t)range_count(set_pair->query.key.range) == strlen(set_pair->query.key.string));
         
-	if (!_read_value (&set_pair->value, text, tmp))
+	if (!_read_value (&set_pair->value, text, context))
 	{
 	    goto fail;
 	}
@@ -442,28 +812,342 @@ static json_object * _read_object (range_const_char * text, json_tmp * tmp)
 fail:
     json_object_clear(object);
     free(object);
-    return NULL;
+    return false;
 
 success:
     text->begin++;
-    return object;
+    return true;
 }
 
-json_value * json_parse (const range_const_char * input)
+static json_object * _read_object (range_const_char * text, json_parser_context * context)
+{
+    json_object * object = calloc (1, sizeof(*object));
+
+    //table_string_resize (object->map, 1031);
+
+    if (!object)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+	
+    assert (*text->begin == '{');
+
+    text->begin++;
+
+    return _read_members (object, text, context, false) ? object : NULL;
+}
+
+static bool _read_shaped_object (json_value * object, range_const_char * input, json_parser_context * context)
+{
+    size_t base = range_count (context->values.region);
+    range_const_char key;
+    json_object * table;
+    json_shape * previous;
+    json_shape * shape;
+    json_shaped * shaped;
+    json_value element;
+    json_value * i;
+    bool expect_pair = false;
+
+    if (!context->shapes && !(context->shapes = json_shape_table_new ()))
+    {
+	return false;
+    }
+
+    shape = &context->shapes->root;
+
+    assert (*input->begin == '{');
+    input->begin++;
+
+    while (true)
+    {
+	if (_identify_next (input) != JSON_STRING)
+	{
+	    if (*input->begin == '}')
+	    {
+		if (expect_pair)
+		{
+		    goto fail;
+		}
+		else
+		{
+		    goto success;
+		}
+	    }
+	    else
+	    {
+		log_fatal ("Object key is type %s, it should be a string\n%s", json_type_name (_identify_next(input)), input->begin);
+	    }
+	}
+
+	if (!_read_checked_string (&context->text, input, context))
+	{
+	    log_fatal ("JSON object key is not a string: %s", input->begin);
+	}
+
+	if (memchr (context->text.region.begin, '\0', range_count (context->text.region)))
+	{
+	    log_fatal ("JSON object key contains \\u0000");
+	}
+
+	_skip_whitespace (input);
+
+	if (*input->begin != ':')
+	{
+	    log_fatal ("Pair separator is missing within JSON object: %s", input->begin);
+	}
+
+	input->begin++;
+
+	previous = shape;
+	shape = json_shape_transition (shape, &context->text.region.alias_const);
+
+	if (!shape)
+	{
+	    // A duplicate key, too many keys or a full shape table, this object gets a table of its own
+	    goto unshaped;
+	}
+
+	if (!_read_value (&element, input, context))
+	{
+	    goto fail;
+	}
+
+	*window_push (context->values) = element;
+
+	expect_pair = false;
+
+	_skip_whitespace (input);
+
+	if (*input->begin == ',')
+	{
+	    expect_pair = true;
+	    input->begin++;
+	}
+    }
+
+unshaped:
+    // The values read so far move into a table, which then takes the rest of the members
+    table = calloc (1, sizeof(*table));
+
+    if (!table)
+    {
+	perror ("calloc");
+	goto fail;
+    }
+
+    for (uint32_t k = 0; k < previous->count; k++)
+    {
+	key.begin = previous->keys[k];
+	key.end = key.begin + previous->key_lengths[k];
+	json_include_range (table, &key)->value = context->values.region.begin[base + k];
+    }
+
+    context->values.region.end = context->values.region.begin + base;
+
+    if (!_read_members (table, input, context, true))
+    {
+	return false;
+    }
+
+    object->object = table;
+    return true;
+
+fail:
+    for (i = context->values.region.begin + base; i < context->values.region.end; i++)
+    {
+	json_value_clear (i);
+    }
+    context->values.region.end = context->values.region.begin + base;
+    return false;
+
+success:
+    shaped = malloc (sizeof(*shaped) + shape->count * sizeof(*shaped->values));
+
+    if (!shaped)
+    {
+	perror ("malloc");
+	goto fail;
+    }
+
+    shaped->shape = shape;
+    memcpy (shaped->values, context->values.region.begin + base, shape->count * sizeof(*shaped->values));
+    json_shape_table_retain (context->shapes);
+
+    object->flags |= JSON_FLAG_SHAPED;
+    object->shaped = shaped;
+    object->count = shape->count;
+
+    context->values.region.end = context->values.region.begin + base;
+    input->begin++;
+    return true;
+}
+
+json_value * json_parse_with (json_parser_context * context, const range_const_char * input)
 {
     range_const_char text = *input;
-    json_tmp tmp = {0};
 
     json_value * value = calloc (1, sizeof(*value));
 
-    if (!_read_value (value, &text, &tmp))
+    if (!_read_value (value, &text, context))
     {
-	free (tmp.text.alloc.begin);
 	json_value_free (value);
 	return NULL;
     }
 
-    free (tmp.text.alloc.begin);
+    return value;
+}
+
+json_type json_scan_next (range_const_char * input)
+{
+    return _identify_next (input);
+}
+
+bool json_scan_punctuation (range_const_char * input, char c)
+{
+    if (!_skip_whitespace (input) || *input->begin != c)
+    {
+	return false;
+    }
+
+    input->begin++;
+
+    return true;
+}
+
+bool json_scan_string (json_parser_context * context, range_const_char * input)
+{
+    if (_identify_next (input) != JSON_STRING)
+    {
+	return false;
+    }
+
+    return _read_checked_string (&context->text, input, context);
+}
+
+static double _convert_number_text (const range_const_char * text);
+
+bool json_scan_number (double * number, range_const_char * input)
+{
+    range_const_char text;
+
+    if (_identify_next (input) != JSON_NUMBER || !_scan_number (&text, input))
+    {
+	return false;
+    }
+
+    *number = _convert_number_text (&text);
+
+    return true;
+}
+
+bool json_scan_number_text (range_const_char * number, range_const_char * input)
+{
+    return _identify_next (input) == JSON_NUMBER && _scan_number (number, input);
+}
+
+static bool _skip_container (json_parser_context * context, range_const_char * input, char close, bool keys)
+{
+    input->begin++;
+
+    if (json_scan_punctuation (input, close))
+    {
+	return true;
+    }
+
+    while (true)
+    {
+	if (keys && (!json_scan_string (context, input) || !json_scan_punctuation (input, ':')))
+	{
+	    log_fatal ("Expected a key and separator within JSON object");
+	}
+
+	if (!json_skip_value (context, input))
+	{
+	    return false;
+	}
+
+	if (json_scan_punctuation (input, close))
+	{
+	    return true;
+	}
+
+	if (!json_scan_punctuation (input, ','))
+	{
+	    log_fatal ("Expected ',' or '%c' within JSON container", close);
+	}
+    }
+
+fail:
+    return false;
+}
+
+bool json_skip_value (json_parser_context * context, range_const_char * input)
+{
+    range_const_char number;
+    
+    switch (_identify_next (input))
+    {
+    case JSON_STRING:
+	return _read_checked_string (&context->text, input, context);
+
+    case JSON_NUMBER:
+	return _scan_number (&number, input);
+
+    case JSON_ARRAY:
+	return _skip_container (context, input, ']', false);
+
+    case JSON_OBJECT:
+	return _skip_container (context, input, '}', true);
+
+    case JSON_FALSE:
+	return _skip_string (input, "false");
+	
+    case JSON_TRUE:
+	return _skip_string (input, "true");
+	
+    case JSON_NULL:
+	return _skip_string (input, "null");
+
+    default:
+	return false;
+    }
+}
+
+bool json_read_value (json_value * value, json_parser_context * context, range_const_char * input)
+{
+    return _read_value (value, input, context);
+}
+
+void json_parser_context_clear (json_parser_context * context)
+{
+    free (context->text.alloc.begin);
+    free (context->values.alloc.begin);
+    json_shape_table_release (context->shapes);
+    context->text = (window_char){0};
+    context->values = (window_json_value){0};
+    context->shapes = NULL;
+}
+
+json_value * json_parse (const range_const_char * input)
+{
+    json_parser_context context = {0};
+
+    json_value * value = json_parse_with (&context, input);
+
+    json_parser_context_clear (&context);
+
+    return value;
+}
+
+json_value * json_parse_utf8 (const range_const_char * input)
+{
+    json_parser_context context = { .validate_utf8 = true };
+
+    json_value * value = json_parse_with (&context, input);
+
+    json_parser_context_clear (&context);
 
     return value;
 }
@@ -526,10 +1210,118 @@ json_value * json_parse (const range_const_char * input)
 
 const char * json_type_name(json_type type)
 {
-    static const char * _name[] = { "null", "number", "true", "false", "string", "array", "object", "badtype" };
+    static const char * _name[] = { "null", "number", "true", "false", "string", "array", "object", "shared", "badtype" };
     return _name[type];
 }
 
+static bool _number_text_is_exact (const range_const_char * text)
+{
+    const char * i;
+    int digits = 0;
+
+    for_range (i, *text)
+    {
+	if (*i == '.' || *i == 'e' || *i == 'E')
+	{
+	    return false;
+	}
+
+	if (*i != '-')
+	{
+	    digits++;
+	}
+    }
+
+    return digits <= 15;
+}
+
+static double _convert_number_text (const range_const_char * text)
+{
+    char buffer[64];
+    char * copy = buffer;
+    size_t size = range_count (*text);
+    double number;
+
+    if (size >= sizeof(buffer))
+    {
+	copy = malloc (size + 1);
+
+	if (!copy)
+	{
+	    perror ("malloc");
+	    return 0;
+	}
+    }
+
+    memcpy (copy, text->begin, size);
+    copy[size] = '\0';
+
+    number = strtod (copy, NULL);
+
+    if (copy != buffer)
+    {
+	free (copy);
+    }
+
+    return number;
+}
+
+// The first read of a lazy number writes through const, json_freeze does it up front for trees shared across threads
+double json_number (const json_value * value)
+{
+    json_value * cache = (json_value*) value;
+    json_number_box * box;
+    range_const_char text;
+    double number;
+
+    assert (value->type == JSON_NUMBER);
+
+    if (!(value->flags & JSON_FLAG_NUMBER_TEXT))
+    {
+	return value->number;
+    }
+
+    if (value->flags & JSON_FLAG_NUMBER_BOXED)
+    {
+	return value->number_box->number;
+    }
+
+    text.begin = value->number_text;
+    text.end = value->number_text + value->count;
+
+    number = _convert_number_text (&text);
+
+    // Short integers lose nothing by dropping their text, others keep it next to the double
+    if (_number_text_is_exact (&text))
+    {
+	cache->flags &= ~JSON_FLAG_NUMBER_TEXT;
+	cache->count = 0;
+	cache->number = number;
+    }
+    else if ((box = malloc (sizeof(*box))))
+    {
+	box->number = number;
+	box->text = value->number_text;
+	cache->flags |= JSON_FLAG_NUMBER_BOXED;
+	cache->number_box = box;
+    }
+
+    return number;
+}
+
+bool json_number_text (range_const_char * text, const json_value * value)
+{
+    if (value->type != JSON_NUMBER || !(value->flags & JSON_FLAG_NUMBER_TEXT))
+    {
+	return false;
+    }
+
+    text->begin = value->flags & JSON_FLAG_NUMBER_BOXED ? value->number_box->text : value->number_text;
+    text->end = text->begin + value->count;
+
+    return true;
+}
+
 typedef struct json_number_options json_number_options;
 struct json_number_options {
     double null_value;
@@ -538,8 +1330,9 @@ struct json_number_options {
 keyargs_define(json_get_bool)
 {
     json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
 
-    if (!pair || pair->value.type == JSON_NULL)
+    if (!value || value->type == JSON_NULL)
     {
 	if (args.optional)
 	{
@@ -549,11 +1342,11 @@ keyargs_define(json_get_bool)
 	log_fatal ("Object has no child %s", args.key);
     }
 
-    if (pair->value.type == JSON_TRUE)
+    if (value->type == JSON_TRUE)
     {
 	return true;
     }
-    else if (pair->value.type == JSON_FALSE)
+    else if (value->type == JSON_FALSE)
     {
 	return false;
     }
@@ -574,8 +1367,9 @@ fail:
 keyargs_define(json_get_number)
 {
     json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
 
-    if (!pair || pair->value.type == JSON_NULL)
+    if (!value || value->type == JSON_NULL)
     {
 	if (args.optional)
 	{
@@ -585,12 +1379,12 @@ keyargs_define(json_get_number)
 	log_fatal ("Object has no child %s", args.key);
     }
 
-    if (pair->value.type != JSON_NUMBER)
+    if (value->type != JSON_NUMBER)
     {
 	log_fatal ("Object child %s is not a number", args.key);
     }
 
-    return pair->value.number;
+    return json_number (value);
 
 fail:
     if (args.success)
@@ -603,8 +1397,9 @@ fail:
 keyargs_define(json_get_string)
 {
     json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
 
-    if (!pair || pair->value.type == JSON_NULL)
+    if (!value || value->type == JSON_NULL)
     {
 	if (args.optional && args.default_value)
 	{
@@ -614,14 +1409,14 @@ keyargs_define(json_get_string)
 	log_fatal ("Object has no child %s", args.key);
     }
 
-    if (pair->value.type != JSON_STRING)
+    if (value->type != JSON_STRING)
     {
 	log_fatal ("Object child %s is not a string", args.key);
     }
 
-    assert (pair->value.string != NULL);
+    assert (value->string != NULL);
 
-    return pair->value.string;
+    return value->string;
 
 fail:
     if (args.success)
@@ -632,11 +1427,52 @@ fail:
     return NULL;
 }
 
+range_const_char json_string_range (const json_value * value)
+{
+    value = json_resolve (value);
+
+    assert (value->type == JSON_STRING);
+
+    return (range_const_char){ .begin = value->string, .end = value->string + value->count };
+}
+
+keyargs_define(json_get_string_range)
+{
+    json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
+
+    if (!value || value->type == JSON_NULL)
+    {
+	if (args.optional && args.default_value)
+	{
+	    return (range_const_char){ .begin = args.default_value, .end = args.default_value + strlen (args.default_value) };
+	}
+	
+	log_fatal ("Object has no child %s", args.key);
+    }
+
+    if (value->type != JSON_STRING)
+    {
+	log_fatal ("Object child %s is not a string", args.key);
+    }
+
+    return json_string_range (value);
+
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+    
+    return (range_const_char){0};
+}
+
 keyargs_define(json_get_array)
 {
     json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
 
-    if (!pair || pair->value.type == JSON_NULL)
+    if (!value || value->type == JSON_NULL)
     {
 	if (!args.optional)
 	{
@@ -648,22 +1484,184 @@ keyargs_define(json_get_array)
 	}
     }
 
-    if (pair->value.type != JSON_ARRAY)
+    if (value->type != JSON_ARRAY)
     {
 	log_fatal ("Object child %s is not an array", args.key);
     }
 
-    return &pair->value.array;
+    return value;
     
 fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
     return NULL;
 }
 
+json_number_array json_packed_numbers (const json_value * value)
+{
+    value = json_resolve (value);
+    
+    if (value->type != JSON_ARRAY || !json_is_packed (value))
+    {
+	return (json_number_array){0};
+    }
+
+    if (value->flags & JSON_FLAG_PACKED_INT64)
+    {
+	return (json_number_array){ .integer = true, .count = value->count, .integers = value->integers };
+    }
+    else
+    {
+	return (json_number_array){ .integer = false, .count = value->count, .doubles = value->doubles };
+    }
+}
+
+double json_number_at (const json_number_array * array, size_t index)
+{
+    assert (index < array->count);
+    
+    return array->integer ? (double) array->integers[index] : array->doubles[index];
+}
+
+const json_value * json_field (const json_value * object, const char * key)
+{
+    json_pair * pair;
+    uint32_t slot;
+
+    object = json_resolve (object);
+
+    if (object->type != JSON_OBJECT)
+    {
+	return NULL;
+    }
+
+    if (object->flags & JSON_FLAG_SHAPED)
+    {
+	return json_shape_slot (&slot, object->shaped->shape, key, strlen (key)) ? json_resolve (object->shaped->values + slot) : NULL;
+    }
+
+    pair = json_lookup_string (object->object, key);
+
+    return pair ? json_resolve (&pair->value) : NULL;
+}
+
+const json_value * json_field_cached (const json_value * object, const char * key, json_field_cache * cache)
+{
+    object = json_resolve (object);
+
+    if (object->type != JSON_OBJECT || !(object->flags & JSON_FLAG_SHAPED))
+    {
+	return json_field (object, key);
+    }
+
+    if (cache->shape != object->shaped->shape)
+    {
+	cache->shape = object->shaped->shape;
+
+	if (!json_shape_slot (&cache->slot, cache->shape, key, strlen (key)))
+	{
+	    cache->slot = UINT32_MAX;
+	}
+    }
+
+    return cache->slot == UINT32_MAX ? NULL : json_resolve (object->shaped->values + cache->slot);
+}
+
+bool json_field_next (json_field_iterator * fields)
+{
+    const json_shape * shape;
+
+    if (fields->object->flags & JSON_FLAG_SHAPED)
+    {
+	if (fields->index == fields->object->count)
+	{
+	    return false;
+	}
+
+	shape = fields->object->shaped->shape;
+	fields->key.begin = shape->keys[fields->index];
+	fields->key.end = fields->key.begin + shape->key_lengths[fields->index];
+	fields->value = fields->object->shaped->values + fields->index++;
+	return true;
+    }
+
+    fields->link = fields->link ? fields->link->peer : NULL;
+
+    while (!fields->link)
+    {
+	if (fields->index == (size_t) range_count (*fields->object->object))
+	{
+	    return false;
+	}
+
+	fields->link = fields->object->object->begin[fields->index++];
+    }
+
+    fields->key = fields->link->child.query.key.range;
+    fields->value = &fields->link->child.value;
+    return true;
+}
+
+size_t json_object_size (const json_value * object)
+{
+    json_field_iterator fields = json_field_iterator (object);
+    size_t count = 0;
+
+    if (fields.object->flags & JSON_FLAG_SHAPED)
+    {
+	return fields.object->count;
+    }
+
+    while (json_field_next (&fields))
+    {
+	count++;
+    }
+
+    return count;
+}
+
+keyargs_define(json_get_number_array)
+{
+    json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
+
+    if (!value || value->type == JSON_NULL)
+    {
+	if (!args.optional)
+	{
+	    log_fatal ("Object has no child %s", args.key);
+	}
+	else
+	{
+	    return (json_number_array){0};
+	}
+    }
+
+    if (value->type != JSON_ARRAY || (!json_is_packed (value) && value->count))
+    {
+	log_fatal ("Object child %s is not a packed number array", args.key);
+    }
+
+    return json_packed_numbers (value);
+    
+fail:
+    if (args.success)
+    {
+	*args.success = false;
+    }
+
+    return (json_number_array){0};
+}
+
 keyargs_define(json_get_object)
 {
     json_pair * pair = json_lookup_string(args.parent, args.key);
+    const json_value * value = pair ? json_resolve(&pair->value) : NULL;
 
-    if (!pair || pair->value.type == JSON_NULL)
+    if (!value || value->type == JSON_NULL)
     {
 	if (!args.optional)
 	{
@@ -675,12 +1673,17 @@ keyargs_define(json_get_object)
 	}
     }
 
-    if (pair->value.type != JSON_OBJECT)
+    if (value->type != JSON_OBJECT)
     {
 	log_fatal ("Object child %s is not an object", args.key);
     }
 
-    return pair->value.object;
+    if (value->flags & JSON_FLAG_SHAPED)
+    {
+	log_fatal ("Object child %s is a shaped object, it should be read with json_field", args.key);
+    }
+
+    return value->object;
 
 fail:
     return NULL;
@@ -1,5 +1,33 @@
 #ifndef FLAT_INCLUDES
+#include <stdbool.h>
 #include "def.h"
+#include "shape.h"
+#include "../window/def.h"
 #endif
 
+window_typedef(json_value, json_value);
+
+typedef struct json_parser_context json_parser_context;
+struct json_parser_context {
+    window_char text;
+    window_json_value values;
+    bool validate_utf8;
+    bool lazy_numbers; // numbers keep their text until first read, which writes the value, so json_freeze a tree before sharing it between threads
+    bool pack_numbers;
+    bool share_shapes;
+    json_shape_table * shapes;
+};
+
 json_value * json_parse (const range_const_char * input);
+json_value * json_parse_utf8 (const range_const_char * input);
+json_value * json_parse_with (json_parser_context * context, const range_const_char * input);
+void json_parser_context_clear (json_parser_context * context);
+
+// Token level access for single pass consumers. Each function skips leading whitespace and advances input past what it read.
+json_type json_scan_next (range_const_char * input);
+bool json_scan_punctuation (range_const_char * input, char c);
+bool json_scan_string (json_parser_context * context, range_const_char * input); // decoded into context->text
+bool json_scan_number (double * number, range_const_char * input);
+bool json_scan_number_text (range_const_char * number, range_const_char * input);
+bool json_skip_value (json_parser_context * context, range_const_char * input);
+bool json_read_value (json_value * value, json_parser_context * context, range_const_char * input);
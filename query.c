@@ -0,0 +1,1410 @@
+#define _GNU_SOURCE
+#include "query.h"
+#include "parse.h"
+#include "traverse.h"
+#include "format.h"
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+#define JSON_QUERY_INITIAL_SLOTS 64
+
+typedef struct json_query_path json_query_path;
+struct json_query_path {
+    char * key;
+    size_t key_length;
+    int slot;
+    json_query_path * children;
+    size_t child_count;
+};
+
+#define JSON_QUERY_OUTSIDE 0
+#define JSON_QUERY_STRING 1
+#define JSON_QUERY_ESCAPE 2
+
+// Where a structural scan stands: in or out of a string and how deeply nested, with the least depth a closing bracket left
+typedef struct json_query_scan json_query_scan;
+struct json_query_scan {
+    int state;
+    ptrdiff_t depth;
+    ptrdiff_t lowest;
+};
+
+typedef struct json_query_chunk json_query_chunk;
+struct json_query_chunk {
+    const char * mark;
+    json_query_scan guesses[2]; // the segment scanned as if it started outside and inside a string
+    json_query_scan start; // the true state at the mark, once the guesses are stitched together
+    range_const_char text;
+    window_char rows;
+};
+
+range_typedef(json_query_chunk, json_query_chunk);
+window_typedef(json_query_chunk, json_query_chunk);
+range_typedef(size_t, json_query_count);
+window_typedef(size_t, json_query_count);
+range_typedef(double, json_query_number);
+window_typedef(double, json_query_number);
+
+typedef struct json_query_groups json_query_groups;
+struct json_query_groups {
+    window_char keys;
+    window_json_query_count key_ends;
+    window_json_query_count counts;
+    window_json_query_number values;
+    window_json_query_count filled;
+    size_t * slots; // one past a group index, zero for an empty slot
+    size_t slot_count;
+};
+
+typedef struct json_query_plan json_query_plan;
+struct json_query_plan {
+    const json_query * query;
+    const char * begin;
+    json_query_path root;
+    int slot_count;
+    int * where_slots;
+    int * select_slots;
+    int * aggregate_slots;
+    int group_slot;
+    bool grouping;
+    bool array;
+    bool summarizing;
+    const char * first;
+    const char * limit;
+    window_json_query_chunk chunks;
+    atomic_size_t next;
+    atomic_bool failed;
+};
+
+typedef struct json_query_worker json_query_worker;
+struct json_query_worker {
+    json_query_plan * plan;
+    json_parser_context context;
+    range_const_char * slots;
+    window_char key;
+    json_query_groups groups;
+    size_t records;
+    size_t matched;
+    pthread_t thread;
+};
+
+static int _compare_bytes (const char * a, size_t a_length, const char * b, size_t b_length)
+{
+    int compare = memcmp (a, b, a_length < b_length ? a_length : b_length);
+
+    if (compare)
+    {
+	return compare;
+    }
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+static uint64_t _hash_bytes (const char * bytes, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+
+    while (size--)
+    {
+	hash = (hash ^ (uint8_t) *bytes++) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+static void _push_bytes (window_char * output, const char * bytes, size_t size)
+{
+    while (size--)
+    {
+	*window_push (*output) = *bytes++;
+    }
+}
+
+static void _push_json_string (window_char * output, const char * string)
+{
+    char escape[8];
+
+    *window_push (*output) = '"';
+
+    for (; *string; string++)
+    {
+	if (*string == '"' || *string == '\\')
+	{
+	    *window_push (*output) = '\\';
+	    *window_push (*output) = *string;
+	}
+	else if ((unsigned char) *string < 0x20)
+	{
+	    snprintf (escape, sizeof(escape), "\\u%04x", (unsigned char) *string);
+	    _push_bytes (output, escape, 6);
+	}
+	else
+	{
+	    *window_push (*output) = *string;
+	}
+    }
+
+    *window_push (*output) = '"';
+}
+
+static void _free_path (json_query_path * path)
+{
+    for (size_t i = 0; i < path->child_count; i++)
+    {
+	_free_path (path->children + i);
+    }
+
+    free (path->key);
+    free (path->children);
+}
+
+static int _add_path (json_query_plan * plan, const char * path)
+{
+    json_query_path * node = &plan->root;
+    json_query_path * children;
+    json_query_path * child;
+    const char * segment = path;
+    const char * end;
+
+    while (true)
+    {
+	end = strchr (segment, '.');
+	end = end ? end : segment + strlen (segment);
+	child = NULL;
+
+	for (size_t i = 0; i < node->child_count && !child; i++)
+	{
+	    if (node->children[i].key_length == (size_t) (end - segment) && 0 == memcmp (node->children[i].key, segment, end - segment))
+	    {
+		child = node->children + i;
+	    }
+	}
+
+	if (!child)
+	{
+	    children = realloc (node->children, (node->child_count + 1) * sizeof(*children));
+
+	    if (!children)
+	    {
+		perror ("realloc");
+		return -1;
+	    }
+
+	    node->children = children;
+	    child = children + node->child_count;
+	    *child = (json_query_path){ .key_length = end - segment, .slot = -1 };
+	    child->key = strndup (segment, end - segment);
+
+	    if (!child->key)
+	    {
+		perror ("strndup");
+		return -1;
+	    }
+
+	    node->child_count++;
+	}
+
+	node = child;
+
+	if (!*end)
+	{
+	    break;
+	}
+
+	segment = end + 1;
+    }
+
+    if (node->slot < 0)
+    {
+	node->slot = plan->slot_count++;
+    }
+
+    return node->slot;
+}
+
+static bool _add_paths (int ** slots, json_query_plan * plan, size_t count, const char * (*path) (const json_query * query, size_t i))
+{
+    *slots = calloc (count + 1, sizeof(**slots));
+
+    if (!*slots)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+	if (!path (plan->query, i))
+	{
+	    log_fatal ("Query path %zu is missing", i);
+	}
+
+	if (((*slots)[i] = _add_path (plan, path (plan->query, i))) < 0)
+	{
+	    return false;
+	}
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+static const char * _where_path (const json_query * query, size_t i)
+{
+    return query->where[i].path;
+}
+
+static const char * _select_path (const json_query * query, size_t i)
+{
+    return query->select[i];
+}
+
+static const char * _aggregate_path (const json_query * query, size_t i)
+{
+    return query->aggregates[i].path;
+}
+
+static const json_query_path * _find_child (const json_query_path * node, const range_const_char * key)
+{
+    for (size_t i = 0; i < node->child_count; i++)
+    {
+	if (node->children[i].key_length == (size_t) range_count (*key) && 0 == memcmp (node->children[i].key, key->begin, range_count (*key)))
+	{
+	    return node->children + i;
+	}
+    }
+
+    return NULL;
+}
+
+static bool _scan_value (json_query_worker * worker, const json_query_path * node, range_const_char * input);
+
+static bool _scan_object (json_query_worker * worker, const json_query_path * node, range_const_char * input)
+{
+    const json_query_path * child;
+
+    input->begin++;
+
+    if (json_scan_punctuation (input, '}'))
+    {
+	return true;
+    }
+
+    while (true)
+    {
+	if (!json_scan_string (&worker->context, input) || !json_scan_punctuation (input, ':'))
+	{
+	    return false;
+	}
+
+	child = _find_child (node, &worker->context.text.region.alias_const);
+
+	if (child ? !_scan_value (worker, child, input) : !json_skip_value (&worker->context, input))
+	{
+	    return false;
+	}
+
+	if (json_scan_punctuation (input, '}'))
+	{
+	    return true;
+	}
+
+	if (!json_scan_punctuation (input, ','))
+	{
+	    return false;
+	}
+    }
+}
+
+static bool _scan_value (json_query_worker * worker, const json_query_path * node, range_const_char * input)
+{
+    json_type type = json_scan_next (input);
+    const char * begin = input->begin;
+
+    // Only members on the way to a wanted path are looked into, everything else is skipped whole
+    if (node->child_count && type == JSON_OBJECT ? !_scan_object (worker, node, input) : !json_skip_value (&worker->context, input))
+    {
+	return false;
+    }
+
+    if (node->slot >= 0)
+    {
+	worker->slots[node->slot] = (range_const_char){ .begin = begin, .end = input->begin };
+    }
+
+    return true;
+}
+
+static bool _test (json_query_worker * worker, const json_query_predicate * predicate, range_const_char raw)
+{
+    const json_value * constant = json_resolve (&predicate->value);
+    json_type type = JSON_NULL;
+    range_const_char string;
+    double number;
+    double other;
+    int compare;
+
+    if (predicate->op == JSON_QUERY_EXISTS)
+    {
+	return raw.begin != NULL;
+    }
+
+    if (raw.begin)
+    {
+	type = json_scan_next (&raw);
+    }
+
+    if (type != constant->type)
+    {
+	return predicate->op == JSON_QUERY_NE;
+    }
+
+    if (type == JSON_NUMBER)
+    {
+	if (!json_scan_number (&number, &raw))
+	{
+	    return false;
+	}
+
+	other = json_number (constant);
+	compare = (number > other) - (number < other);
+    }
+    else if (type == JSON_STRING)
+    {
+	if (!json_scan_string (&worker->context, &raw))
+	{
+	    return false;
+	}
+
+	string = json_string_range (constant);
+	compare = _compare_bytes (worker->context.text.region.begin, range_count (worker->context.text.region), string.begin, range_count (string));
+    }
+    else
+    {
+	// null, true and false are only equal or not
+	return predicate->op == JSON_QUERY_EQ;
+    }
+
+    switch (predicate->op)
+    {
+    case JSON_QUERY_EQ: return compare == 0;
+    case JSON_QUERY_NE: return compare != 0;
+    case JSON_QUERY_LT: return compare < 0;
+    case JSON_QUERY_LE: return compare <= 0;
+    case JSON_QUERY_GT: return compare > 0;
+    case JSON_QUERY_GE: return compare >= 0;
+    default: return false;
+    }
+}
+
+static void _group_key (json_query_worker * worker, range_const_char raw)
+{
+    json_type type = JSON_NULL;
+    double number;
+
+    window_rewrite (worker->key);
+
+    if (raw.begin)
+    {
+	type = json_scan_next (&raw);
+    }
+
+    // Scalar keys are canonical so that equal values with different spellings share a group
+    switch (type)
+    {
+    case JSON_NULL:
+	*window_push (worker->key) = 'z';
+	break;
+
+    case JSON_FALSE:
+	*window_push (worker->key) = 'f';
+	break;
+
+    case JSON_TRUE:
+	*window_push (worker->key) = 't';
+	break;
+
+    case JSON_NUMBER:
+	json_scan_number (&number, &raw);
+	number = number == 0 ? 0 : number;
+	*window_push (worker->key) = 'n';
+	_push_bytes (&worker->key, (const char*) &number, sizeof(number));
+	break;
+
+    case JSON_STRING:
+	json_scan_string (&worker->context, &raw);
+	*window_push (worker->key) = 's';
+	_push_bytes (&worker->key, worker->context.text.region.begin, range_count (worker->context.text.region));
+	break;
+
+    default:
+	*window_push (worker->key) = 'r';
+	json_minify (&worker->key, &raw);
+	break;
+    }
+}
+
+static range_const_char _group_key_range (const json_query_groups * groups, size_t group)
+{
+    return (range_const_char){ .begin = groups->keys.region.begin + groups->key_ends.region.begin[group],
+	                       .end = groups->keys.region.begin + groups->key_ends.region.begin[group + 1] };
+}
+
+static bool _grow_groups (json_query_groups * groups)
+{
+    size_t count = groups->slot_count ? groups->slot_count * 2 : JSON_QUERY_INITIAL_SLOTS;
+    size_t * slots = calloc (count, sizeof(*slots));
+    range_const_char key;
+    size_t i;
+
+    if (!slots)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    for (size_t group = 0; group < (size_t) range_count (groups->counts.region); group++)
+    {
+	key = _group_key_range (groups, group);
+
+	for (i = _hash_bytes (key.begin, range_count (key)) & (count - 1); slots[i]; i = (i + 1) & (count - 1))
+	{
+	}
+
+	slots[i] = group + 1;
+    }
+
+    free (groups->slots);
+    groups->slots = slots;
+    groups->slot_count = count;
+
+    return true;
+}
+
+static size_t _group (json_query_groups * groups, const json_query * query, const range_const_char * key)
+{
+    size_t count = range_count (groups->counts.region);
+    range_const_char candidate;
+    size_t group;
+    size_t i;
+
+    if ((count + 1) * 2 > groups->slot_count && !_grow_groups (groups))
+    {
+	return SIZE_MAX;
+    }
+
+    for (i = _hash_bytes (key->begin, range_count (*key)) & (groups->slot_count - 1); groups->slots[i]; i = (i + 1) & (groups->slot_count - 1))
+    {
+	group = groups->slots[i] - 1;
+	candidate = _group_key_range (groups, group);
+
+	if (0 == _compare_bytes (candidate.begin, range_count (candidate), key->begin, range_count (*key)))
+	{
+	    return group;
+	}
+    }
+
+    if (range_is_empty (groups->key_ends.region))
+    {
+	*window_push (groups->key_ends) = 0;
+    }
+
+    _push_bytes (&groups->keys, key->begin, range_count (*key));
+    *window_push (groups->key_ends) = range_count (groups->keys.region);
+    *window_push (groups->counts) = 0;
+
+    for (size_t a = 0; a < query->aggregate_count; a++)
+    {
+	*window_push (groups->values) = query->aggregates[a].function == JSON_QUERY_MIN ? INFINITY
+	    : query->aggregates[a].function == JSON_QUERY_MAX ? -INFINITY : 0;
+	*window_push (groups->filled) = 0;
+    }
+
+    groups->slots[i] = count + 1;
+
+    return count;
+}
+
+static void _fold (double * value, json_query_function function, double number)
+{
+    switch (function)
+    {
+    case JSON_QUERY_SUM: *value += number; break;
+    case JSON_QUERY_MIN: *value = number < *value ? number : *value; break;
+    case JSON_QUERY_MAX: *value = number > *value ? number : *value; break;
+    }
+}
+
+static bool _accumulate (json_query_worker * worker)
+{
+    const json_query * query = worker->plan->query;
+    size_t group;
+    range_const_char raw;
+    double number;
+
+    _group_key (worker, worker->plan->group_slot < 0 ? (range_const_char){0} : worker->slots[worker->plan->group_slot]);
+
+    group = _group (&worker->groups, query, &worker->key.region.alias_const);
+
+    if (group == SIZE_MAX)
+    {
+	return false;
+    }
+
+    worker->groups.counts.region.begin[group]++;
+
+    for (size_t a = 0; a < query->aggregate_count; a++)
+    {
+	raw = worker->slots[worker->plan->aggregate_slots[a]];
+
+	if (raw.begin && json_scan_next (&raw) == JSON_NUMBER && json_scan_number (&number, &raw))
+	{
+	    _fold (worker->groups.values.region.begin + group * query->aggregate_count + a, query->aggregates[a].function, number);
+	    worker->groups.filled.region.begin[group * query->aggregate_count + a]++;
+	}
+    }
+
+    return true;
+}
+
+static void _project (json_query_worker * worker, json_query_chunk * chunk, const range_const_char * record)
+{
+    const json_query * query = worker->plan->query;
+    range_const_char raw;
+
+    if (!query->select_count)
+    {
+	json_minify (&chunk->rows, record);
+	*window_push (chunk->rows) = '\n';
+	return;
+    }
+
+    *window_push (chunk->rows) = '{';
+
+    for (size_t s = 0; s < query->select_count; s++)
+    {
+	if (s)
+	{
+	    *window_push (chunk->rows) = ',';
+	}
+
+	_push_json_string (&chunk->rows, query->select[s]);
+	*window_push (chunk->rows) = ':';
+
+	raw = worker->slots[worker->plan->select_slots[s]];
+
+	if (raw.begin)
+	{
+	    json_minify (&chunk->rows, &raw);
+	}
+	else
+	{
+	    _push_bytes (&chunk->rows, "null", 4);
+	}
+    }
+
+    *window_push (chunk->rows) = '}';
+    *window_push (chunk->rows) = '\n';
+}
+
+static bool _record (json_query_worker * worker, json_query_chunk * chunk, range_const_char * input)
+{
+    const json_query_plan * plan = worker->plan;
+    range_const_char record = { .begin = input->begin };
+
+    for (int i = 0; i < plan->slot_count; i++)
+    {
+	worker->slots[i] = (range_const_char){0};
+    }
+
+    if (!_scan_value (worker, &plan->root, input))
+    {
+	log_fatal ("Malformed record at byte %zu", (size_t) (record.begin - plan->begin));
+    }
+
+    record.end = input->begin;
+    worker->records++;
+
+    for (size_t i = 0; i < plan->query->where_count; i++)
+    {
+	if (!_test (worker, plan->query->where + i, worker->slots[plan->where_slots[i]]))
+	{
+	    return true;
+	}
+    }
+
+    worker->matched++;
+
+    if (plan->grouping)
+    {
+	return _accumulate (worker);
+    }
+
+    _project (worker, chunk, &record);
+
+    return true;
+
+fail:
+    return false;
+}
+
+// The structural scan is a table driven state machine over the bytes that matter: quotes, backslashes and brackets
+static const unsigned char _byte_class[256] = { ['"'] = 1, ['\\'] = 2, ['['] = 3, ['{'] = 3, [']'] = 4, ['}'] = 4 };
+
+static const unsigned char _next_state[3][5] = {
+    [JSON_QUERY_OUTSIDE] = { JSON_QUERY_OUTSIDE, JSON_QUERY_STRING, JSON_QUERY_OUTSIDE, JSON_QUERY_OUTSIDE, JSON_QUERY_OUTSIDE },
+    [JSON_QUERY_STRING] = { JSON_QUERY_STRING, JSON_QUERY_OUTSIDE, JSON_QUERY_ESCAPE, JSON_QUERY_STRING, JSON_QUERY_STRING },
+    [JSON_QUERY_ESCAPE] = { JSON_QUERY_STRING, JSON_QUERY_STRING, JSON_QUERY_STRING, JSON_QUERY_STRING, JSON_QUERY_STRING },
+};
+
+static const signed char _depth_change[3][5] = { [JSON_QUERY_OUTSIDE] = { 0, 0, 0, 1, -1 } };
+
+static void _scan_structure (json_query_scan * scan, const char * begin, const char * end)
+{
+    unsigned byte_class;
+
+    for (const char * c = begin; c < end; c++)
+    {
+	byte_class = _byte_class[(unsigned char) *c];
+	scan->depth += _depth_change[scan->state][byte_class];
+	scan->state = _next_state[scan->state][byte_class];
+	scan->lowest = scan->depth < scan->lowest ? scan->depth : scan->lowest;
+    }
+}
+
+static const char * _segment_end (const json_query_plan * plan, size_t index)
+{
+    return index + 1 < (size_t) range_count (plan->chunks.region) ? plan->chunks.region.begin[index + 1].mark : plan->limit;
+}
+
+// Finds the first record boundary at or after the mark of a segment and before limit, or NULL. Inside a top
+// level array that is a comma between elements, in a stream whitespace between values or the end of a bracket.
+static const char * _boundary (const json_query_plan * plan, size_t index, const char * limit)
+{
+    json_query_scan scan = plan->chunks.region.begin[index].start;
+
+    for (const char * c = plan->chunks.region.begin[index].mark; c < limit; c++)
+    {
+	if (scan.state != JSON_QUERY_OUTSIDE)
+	{
+	    _scan_structure (&scan, c, c + 1);
+	    continue;
+	}
+
+	switch (*c)
+	{
+	case '"':
+	    scan.state = JSON_QUERY_STRING;
+	    break;
+
+	case '[':
+	case '{':
+	    scan.depth++;
+	    break;
+
+	case ']':
+	case '}':
+	    if (--scan.depth == 0 && !plan->array)
+	    {
+		return c + 1;
+	    }
+	    break;
+
+	case ',':
+	    if (scan.depth == 1 && plan->array)
+	    {
+		return c;
+	    }
+	    break;
+
+	case ' ':
+	case '\t':
+	case '\n':
+	case '\r':
+	    if (scan.depth == 0 && !plan->array)
+	    {
+		return c;
+	    }
+	    break;
+	}
+    }
+
+    return NULL;
+}
+
+// Each worker finds the records of its own segment: those that begin at the first boundary past its mark, up to the first boundary past
+// the next mark. A segment where no record begins has nothing to do, the one before it reaches over it
+static bool _cut (const json_query_plan * plan, json_query_chunk * chunk, size_t index)
+{
+    const char * end = _segment_end (plan, index);
+    const char * begin = plan->first;
+
+    if (index > 0)
+    {
+	begin = _boundary (plan, index, end < plan->limit ? end : plan->limit);
+
+	if (!begin)
+	{
+	    return false;
+	}
+
+	// An array chunk starts behind the comma that separates it from the previous one
+	begin += plan->array;
+    }
+
+    if (end < plan->limit)
+    {
+	end = _boundary (plan, index + 1, plan->limit);
+    }
+
+    end = end && end < plan->limit ? end : plan->limit;
+
+    chunk->text = (range_const_char){ .begin = begin, .end = end };
+
+    return true;
+}
+
+static bool _chunk (json_query_worker * worker, json_query_chunk * chunk, size_t index)
+{
+    const json_query_plan * plan = worker->plan;
+    range_const_char text;
+
+    // Array chunks after the first start behind a separating comma, so they may not be empty
+    bool expect = plan->array && index > 0;
+
+    if (!_cut (plan, chunk, index))
+    {
+	return true;
+    }
+
+    text = chunk->text;
+
+    while (true)
+    {
+	json_scan_next (&text);
+
+	if (text.begin == text.end)
+	{
+	    if (expect)
+	    {
+		log_fatal ("Expected an array element at byte %zu", (size_t) (text.begin - plan->begin));
+	    }
+
+	    return true;
+	}
+
+	if (!_record (worker, chunk, &text))
+	{
+	    return false;
+	}
+
+	expect = false;
+
+	if (!plan->array)
+	{
+	    continue;
+	}
+
+	json_scan_next (&text);
+
+	if (text.begin == text.end)
+	{
+	    return true;
+	}
+
+	if (!json_scan_punctuation (&text, ','))
+	{
+	    log_fatal ("Expected ',' between array elements at byte %zu", (size_t) (text.begin - plan->begin));
+	}
+
+	expect = true;
+    }
+
+fail:
+    return false;
+}
+
+// Both guesses are scanned in a single pass over the segment
+static void _summarize (json_query_plan * plan, json_query_chunk * chunk, size_t index)
+{
+    const char * end = _segment_end (plan, index);
+    json_query_scan outside = { .state = JSON_QUERY_OUTSIDE };
+    json_query_scan inside = { .state = JSON_QUERY_STRING };
+    unsigned byte_class;
+
+    for (const char * c = chunk->mark; c < end; c++)
+    {
+	// Most bytes change neither guess, and skipping them does not wait on the state of the last byte. Only an escaped byte counts whatever it is
+	while (c < end && !_byte_class[(unsigned char) *c] && outside.state != JSON_QUERY_ESCAPE && inside.state != JSON_QUERY_ESCAPE)
+	{
+	    c++;
+	}
+
+	if (c == end)
+	{
+	    break;
+	}
+
+	byte_class = _byte_class[(unsigned char) *c];
+	outside.depth += _depth_change[outside.state][byte_class];
+	outside.state = _next_state[outside.state][byte_class];
+	outside.lowest = outside.depth < outside.lowest ? outside.depth : outside.lowest;
+	inside.depth += _depth_change[inside.state][byte_class];
+	inside.state = _next_state[inside.state][byte_class];
+	inside.lowest = inside.depth < inside.lowest ? inside.depth : inside.lowest;
+    }
+
+    chunk->guesses[0] = outside;
+    chunk->guesses[1] = inside;
+}
+
+static void * _work (void * arg)
+{
+    json_query_worker * worker = arg;
+    json_query_plan * plan = worker->plan;
+    size_t count = range_count (plan->chunks.region);
+    size_t index;
+
+    while (!atomic_load_explicit (&plan->failed, memory_order_relaxed))
+    {
+	index = atomic_fetch_add_explicit (&plan->next, 1, memory_order_relaxed);
+
+	if (index >= count)
+	{
+	    break;
+	}
+
+	if (plan->summarizing)
+	{
+	    _summarize (plan, plan->chunks.region.begin + index, index);
+	}
+	else if (!_chunk (worker, plan->chunks.region.begin + index, index))
+	{
+	    atomic_store (&plan->failed, true);
+	    break;
+	}
+    }
+
+    return NULL;
+}
+
+// The calling thread is the first worker, the others are started for each pass over the chunks
+static bool _run_workers (json_query_plan * plan, json_query_worker * workers, long threads)
+{
+    long started = 1;
+
+    atomic_store (&plan->next, 0);
+
+    for (; started < threads; started++)
+    {
+	if (0 != pthread_create (&workers[started].thread, NULL, _work, workers + started))
+	{
+	    perror ("pthread_create");
+	    break;
+	}
+    }
+
+    _work (workers);
+
+    for (long i = 1; i < started; i++)
+    {
+	pthread_join (workers[i].thread, NULL);
+    }
+
+    return !atomic_load (&plan->failed);
+}
+
+// Segments begin every JSON_QUERY_CHUNK_SIZE bytes, but never right behind a backslash, so no mark can fall within an escape.
+// The first starts past a leading '[', so that every depth up to the matching ']' is positive
+static void _split (json_query_plan * plan, const range_const_char * input)
+{
+    range_const_char text = *input;
+    const char * mark = json_scan_next (&text) == JSON_ARRAY ? text.begin + 1 : input->begin;
+
+    plan->limit = input->end;
+
+    while (mark < input->end)
+    {
+	*window_push (plan->chunks) = (json_query_chunk){ .mark = mark };
+
+	mark = input->end - mark > JSON_QUERY_CHUNK_SIZE ? mark + JSON_QUERY_CHUNK_SIZE : input->end;
+
+	while (mark < input->end && mark[-1] == '\\')
+	{
+	    mark++;
+	}
+    }
+}
+
+// Chains the guesses of every segment into the true state at its mark, then settles whether the input is one array.
+// A stream of arrays starts with '[' too, so the input is only one array when nothing but whitespace follows its ']'
+static bool _stitch (json_query_plan * plan, const range_const_char * input)
+{
+    range_const_char text = *input;
+    bool array = json_scan_next (&text) == JSON_ARRAY;
+    json_query_scan scan = { .state = JSON_QUERY_OUTSIDE, .depth = array };
+    const json_query_scan * guess;
+    range_const_char rest;
+    const char * close = NULL;
+    json_query_chunk * chunk;
+    const char * c;
+    bool outside;
+
+    for_range (chunk, plan->chunks.region)
+    {
+	chunk->start = (json_query_scan){ .state = scan.state, .depth = scan.depth };
+	guess = chunk->guesses + (scan.state == JSON_QUERY_STRING);
+
+	// The closing bracket of a top level array is the first to bring the depth back to zero
+	if (array && !close && guess->lowest <= -scan.depth)
+	{
+	    for (c = chunk->mark; !close && c < _segment_end (plan, chunk - plan->chunks.region.begin); c++)
+	    {
+		outside = scan.state == JSON_QUERY_OUTSIDE;
+		_scan_structure (&scan, c, c + 1);
+
+		if (outside && (*c == ']' || *c == '}') && scan.depth == 0)
+		{
+		    close = c;
+		}
+	    }
+	}
+
+	scan.state = guess->state;
+	scan.depth = chunk->start.depth + guess->depth;
+    }
+
+    plan->array = false;
+    plan->first = input->begin;
+
+    if (!array)
+    {
+	return true;
+    }
+
+    if (!close)
+    {
+	log_fatal ("The top level array is not terminated");
+    }
+
+    rest = (range_const_char){ .begin = close + 1, .end = input->end };
+    json_scan_next (&rest);
+
+    if (rest.begin != rest.end)
+    {
+	return true;
+    }
+
+    if (*close != ']')
+    {
+	log_fatal ("Unexpected input after the top level array at byte %zu", (size_t) (close - plan->begin));
+    }
+
+    plan->array = true;
+    plan->first = text.begin + 1;
+    plan->limit = close;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _merge (json_query_worker * into, const json_query_worker * from)
+{
+    const json_query * query = into->plan->query;
+    range_const_char key;
+    size_t group;
+    size_t a_into;
+    size_t a_from;
+
+    for (size_t g = 0; g < (size_t) range_count (from->groups.counts.region); g++)
+    {
+	key = _group_key_range (&from->groups, g);
+	group = _group (&into->groups, query, &key);
+
+	if (group == SIZE_MAX)
+	{
+	    return false;
+	}
+
+	into->groups.counts.region.begin[group] += from->groups.counts.region.begin[g];
+
+	for (size_t a = 0; a < query->aggregate_count; a++)
+	{
+	    a_into = group * query->aggregate_count + a;
+	    a_from = g * query->aggregate_count + a;
+
+	    if (from->groups.filled.region.begin[a_from])
+	    {
+		_fold (into->groups.values.region.begin + a_into, query->aggregates[a].function, from->groups.values.region.begin[a_from]);
+		into->groups.filled.region.begin[a_into] += from->groups.filled.region.begin[a_from];
+	    }
+	}
+    }
+
+    return true;
+}
+
+static int _key_rank (char kind)
+{
+    switch (kind)
+    {
+    case 'z': return 0;
+    case 'f': return 1;
+    case 't': return 2;
+    case 'n': return 3;
+    case 's': return 4;
+    default: return 5;
+    }
+}
+
+static int _compare_groups (const void * a, const void * b, void * arg)
+{
+    const json_query_groups * groups = arg;
+    range_const_char a_key = _group_key_range (groups, *(const size_t*) a);
+    range_const_char b_key = _group_key_range (groups, *(const size_t*) b);
+    int a_rank = _key_rank (*a_key.begin);
+    int b_rank = _key_rank (*b_key.begin);
+    double a_number;
+    double b_number;
+
+    if (a_rank != b_rank)
+    {
+	return a_rank - b_rank;
+    }
+
+    if (*a_key.begin == 'n')
+    {
+	memcpy (&a_number, a_key.begin + 1, sizeof(a_number));
+	memcpy (&b_number, b_key.begin + 1, sizeof(b_number));
+	return (a_number > b_number) - (a_number < b_number);
+    }
+
+    return _compare_bytes (a_key.begin, range_count (a_key), b_key.begin, range_count (b_key));
+}
+
+static json_value * _include (json_object * object, const char * key)
+{
+    range_const_char range = { .begin = key, .end = key + strlen (key) };
+
+    return &json_include_range (object, &range)->value;
+}
+
+static bool _key_value (json_value * value, const range_const_char * key)
+{
+    range_const_char rest = { .begin = key->begin + 1, .end = key->end };
+    json_value * parsed;
+
+    switch (*key->begin)
+    {
+    case 'z':
+	*value = (json_value){ .type = JSON_NULL };
+	return true;
+
+    case 'f':
+	*value = (json_value){ .type = JSON_FALSE };
+	return true;
+
+    case 't':
+	*value = (json_value){ .type = JSON_TRUE };
+	return true;
+
+    case 'n':
+	*value = (json_value){ .type = JSON_NUMBER };
+	memcpy (&value->number, rest.begin, sizeof(value->number));
+	return true;
+
+    case 's':
+	*value = (json_value){ .type = JSON_STRING, .count = range_count (rest) };
+	value->string = malloc (range_count (rest) + 1);
+
+	if (!value->string)
+	{
+	    perror ("malloc");
+	    return false;
+	}
+
+	// Copied by length, the string may hold escaped NULs
+	memcpy (value->string, rest.begin, range_count (rest));
+	value->string[range_count (rest)] = '\0';
+	return true;
+
+    default:
+	parsed = json_parse (&rest);
+
+	if (!parsed)
+	{
+	    return false;
+	}
+
+	*value = *parsed;
+	free (parsed);
+	return true;
+    }
+}
+
+static bool _build_groups (json_value * output, const json_query * query, const json_query_groups * groups)
+{
+    size_t count = range_count (groups->counts.region);
+    size_t * order = malloc ((count + 1) * sizeof(*order));
+    range_const_char key;
+    json_value * element;
+    json_value * value;
+    size_t index;
+
+    *output = (json_value){ .type = JSON_ARRAY };
+    output->elements = calloc (count + 1, sizeof(*output->elements));
+
+    if (!order || !output->elements)
+    {
+	perror ("malloc");
+	free (order);
+	return false;
+    }
+
+    output->count = count;
+
+    for (size_t g = 0; g < count; g++)
+    {
+	order[g] = g;
+    }
+
+    qsort_r (order, count, sizeof(*order), _compare_groups, (void*) groups);
+
+    for (size_t g = 0; g < count; g++)
+    {
+	element = output->elements + g;
+	index = order[g];
+	element->type = JSON_OBJECT;
+	element->object = calloc (1, sizeof(*element->object));
+
+	if (!element->object)
+	{
+	    perror ("calloc");
+	    goto fail;
+	}
+
+	key = _group_key_range (groups, index);
+
+	if (!_key_value (_include (element->object, "key"), &key))
+	{
+	    goto fail;
+	}
+
+	*_include (element->object, "count") = (json_value){ .type = JSON_NUMBER, .number = groups->counts.region.begin[index] };
+
+	for (size_t a = 0; a < query->aggregate_count; a++)
+	{
+	    value = _include (element->object, query->aggregates[a].name);
+
+	    if (query->aggregates[a].function != JSON_QUERY_SUM && !groups->filled.region.begin[index * query->aggregate_count + a])
+	    {
+		*value = (json_value){ .type = JSON_NULL };
+	    }
+	    else
+	    {
+		*value = (json_value){ .type = JSON_NUMBER, .number = groups->values.region.begin[index * query->aggregate_count + a] };
+	    }
+	}
+    }
+
+    free (order);
+    return true;
+
+fail:
+    free (order);
+    json_value_clear (output);
+    *output = (json_value){0};
+    return false;
+}
+
+static void _clear_groups (json_query_groups * groups)
+{
+    free (groups->keys.alloc.begin);
+    free (groups->key_ends.alloc.begin);
+    free (groups->counts.alloc.begin);
+    free (groups->values.alloc.begin);
+    free (groups->filled.alloc.begin);
+    free (groups->slots);
+}
+
+static bool _plan (json_query_plan * plan)
+{
+    const json_query * query = plan->query;
+    json_type type;
+
+    for (size_t a = 0; a < query->aggregate_count; a++)
+    {
+	if (!query->aggregates[a].name || 0 == strcmp (query->aggregates[a].name, "key") || 0 == strcmp (query->aggregates[a].name, "count"))
+	{
+	    log_fatal ("Aggregate %zu needs a name other than key or count", a);
+	}
+    }
+
+    // Records are never built, so arrays and objects have no canonical form to compare against
+    for (size_t w = 0; w < query->where_count; w++)
+    {
+	type = json_resolve (&query->where[w].value)->type;
+
+	if (query->where[w].op != JSON_QUERY_EXISTS && (type == JSON_ARRAY || type == JSON_OBJECT || type == JSON_BADTYPE))
+	{
+	    log_fatal ("Predicate on %s compares against %s, only scalars can be compared", query->where[w].path, json_type_name (type));
+	}
+    }
+
+    plan->group_slot = -1;
+    plan->grouping = query->group_by || query->aggregate_count;
+
+    if (!_add_paths (&plan->where_slots, plan, query->where_count, _where_path)
+	|| !_add_paths (&plan->select_slots, plan, query->select_count, _select_path)
+	|| !_add_paths (&plan->aggregate_slots, plan, query->aggregate_count, _aggregate_path))
+    {
+	return false;
+    }
+
+    if (query->group_by && (plan->group_slot = _add_path (plan, query->group_by)) < 0)
+    {
+	return false;
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+bool json_query_run (json_query_result * result, const json_query * query, const range_const_char * input)
+{
+    json_query_plan plan = { .query = query, .begin = input->begin, .root = { .slot = -1 } };
+    json_query_worker * workers = NULL;
+    json_query_chunk * chunk;
+    size_t chunk_count;
+    long threads = query->threads;
+    bool success = false;
+
+    *result = (json_query_result){0};
+
+    if (!_plan (&plan))
+    {
+	goto done;
+    }
+
+    _split (&plan, input);
+
+    chunk_count = range_count (plan.chunks.region);
+
+    if (threads <= 0)
+    {
+	threads = sysconf (_SC_NPROCESSORS_ONLN);
+    }
+
+    threads = threads < 1 ? 1 : (size_t) threads > chunk_count ? (long) chunk_count : threads;
+    threads = threads < 1 ? 1 : threads;
+
+    workers = calloc (threads, sizeof(*workers));
+
+    if (!workers)
+    {
+	perror ("calloc");
+	goto done;
+    }
+
+    for (long i = 0; i < threads; i++)
+    {
+	workers[i].plan = &plan;
+	workers[i].slots = calloc (plan.slot_count + 1, sizeof(*workers[i].slots));
+
+	if (!workers[i].slots)
+	{
+	    perror ("calloc");
+	    goto done;
+	}
+    }
+
+    // Segments are scanned in parallel first, only the stitching of their scans is left to the calling thread
+    plan.summarizing = true;
+    _run_workers (&plan, workers, threads);
+    plan.summarizing = false;
+
+    if (!_stitch (&plan, input) || !_run_workers (&plan, workers, threads))
+    {
+	goto done;
+    }
+
+    for (long i = 0; i < threads; i++)
+    {
+	result->records += workers[i].records;
+	result->matched += workers[i].matched;
+
+	if (i && plan.grouping && !_merge (workers, workers + i))
+	{
+	    goto done;
+	}
+    }
+
+    if (plan.grouping)
+    {
+	if (!_build_groups (&result->groups, query, &workers->groups))
+	{
+	    goto done;
+	}
+    }
+    else
+    {
+	for_range (chunk, plan.chunks.region)
+	{
+	    _push_bytes (&result->rows, chunk->rows.region.begin, range_count (chunk->rows.region));
+	}
+    }
+
+    success = true;
+
+done:
+    for (long i = 0; workers && i < threads; i++)
+    {
+	json_parser_context_clear (&workers[i].context);
+	free (workers[i].slots);
+	free (workers[i].key.alloc.begin);
+	_clear_groups (&workers[i].groups);
+    }
+
+    for_range (chunk, plan.chunks.region)
+    {
+	free (chunk->rows.alloc.begin);
+    }
+
+    free (workers);
+    free (plan.chunks.alloc.begin);
+    free (plan.where_slots);
+    free (plan.select_slots);
+    free (plan.aggregate_slots);
+    _free_path (&plan.root);
+
+    if (!success)
+    {
+	json_query_result_clear (result);
+    }
+
+    return success;
+}
+
+void json_query_result_clear (json_query_result * result)
+{
+    free (result->rows.alloc.begin);
+    json_value_clear (&result->groups);
+    *result = (json_query_result){0};
+}
@@ -0,0 +1,94 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#include "../window/def.h"
+#endif
+
+/*
+  A small filter and aggregate engine over a stream of records, either
+  whitespace separated values as in NDJSON or the elements of a top
+  level array. Records of a stream may span several lines. Input that
+  starts with '[' is one array only when nothing but whitespace follows
+  its closing bracket; otherwise, as in an NDJSON stream of arrays,
+  every top level value is a record. The input is cut into chunks at
+  record boundaries and the chunks are scanned by a pool of worker
+  threads. Finding the boundaries is split between the workers too:
+  each summarizes the string and nesting state of its own segment, the
+  summaries are chained, and each worker then resyncs to the first
+  boundary past its segment's start. Records are never built into
+  json_values: every path the query mentions is located in a single
+  scan of the record, and the bytes of all other members are skipped.
+
+  Paths are member names joined by '.', such as "request.status". A
+  record matches when every predicate in where holds; a missing member
+  compares as null, and JSON_QUERY_EXISTS only tests that the member is
+  present. Predicate values must be scalars. Comparisons against a
+  number or string only order values of the same type.
+
+  Without group_by or aggregates, result->rows receives one line per
+  matching record, in input order: an object of the selected paths and
+  their values, or the whole record when nothing is selected. Otherwise
+  the matching records are grouped by the value at group_by (all in one
+  group with a null key when group_by is not set), and result->groups
+  is an array of objects holding "key", "count" and each aggregate
+  under its name, sorted by key. Aggregates only see numbers; a min or
+  max over a group without numbers is null.
+*/
+
+#define JSON_QUERY_CHUNK_SIZE (1 << 20)
+
+typedef enum json_query_op {
+    JSON_QUERY_EXISTS,
+    JSON_QUERY_EQ,
+    JSON_QUERY_NE,
+    JSON_QUERY_LT,
+    JSON_QUERY_LE,
+    JSON_QUERY_GT,
+    JSON_QUERY_GE,
+}
+    json_query_op;
+
+typedef enum json_query_function {
+    JSON_QUERY_SUM,
+    JSON_QUERY_MIN,
+    JSON_QUERY_MAX,
+}
+    json_query_function;
+
+typedef struct json_query_predicate json_query_predicate;
+struct json_query_predicate {
+    const char * path;
+    json_query_op op;
+    json_value value;
+};
+
+typedef struct json_query_aggregate json_query_aggregate;
+struct json_query_aggregate {
+    const char * name;
+    json_query_function function;
+    const char * path;
+};
+
+typedef struct json_query json_query;
+struct json_query {
+    const json_query_predicate * where;
+    size_t where_count;
+    const char * const * select;
+    size_t select_count;
+    const char * group_by;
+    const json_query_aggregate * aggregates;
+    size_t aggregate_count;
+    int threads; // 0 for one per online processor
+};
+
+typedef struct json_query_result json_query_result;
+struct json_query_result {
+    size_t records;
+    size_t matched;
+    window_char rows;
+    json_value groups;
+};
+
+bool json_query_run (json_query_result * result, const json_query * query, const range_const_char * input);
+void json_query_result_clear (json_query_result * result);
@@ -0,0 +1,208 @@
+#include "reclaim.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+
+typedef struct json_reclaim_node json_reclaim_node;
+struct json_reclaim_node {
+    json_reclaim_node * next;
+    json_value value;
+};
+
+static struct {
+    pthread_mutex_t lock; // serializes starting and stopping
+    pthread_mutex_t flush_lock;
+    pthread_cond_t flushed;
+    pthread_t thread;
+    sem_t wake;
+    _Atomic(json_reclaim_node *) head;
+    atomic_bool running;
+    atomic_bool stop;
+    atomic_int pushing;
+    atomic_size_t queued;
+    atomic_size_t freed;
+}
+    _reclaimer = { .lock = PTHREAD_MUTEX_INITIALIZER, .flush_lock = PTHREAD_MUTEX_INITIALIZER, .flushed = PTHREAD_COND_INITIALIZER };
+
+static size_t _free_list (json_reclaim_node * node)
+{
+    json_reclaim_node * reversed = NULL;
+    json_reclaim_node * next;
+    size_t count = 0;
+
+    // The list is newest first, free in the order values were deferred
+    while (node)
+    {
+	next = node->next;
+	node->next = reversed;
+	reversed = node;
+	node = next;
+    }
+
+    while (reversed)
+    {
+	next = reversed->next;
+	json_value_clear (&reversed->value);
+	free (reversed);
+	reversed = next;
+	count++;
+    }
+
+    return count;
+}
+
+static void * _reclaim_thread (void * arg)
+{
+    size_t count;
+
+    while (true)
+    {
+	while (0 != sem_wait (&_reclaimer.wake))
+	{
+	    // interrupted by a signal
+	}
+
+	count = _free_list (atomic_exchange_explicit (&_reclaimer.head, NULL, memory_order_acquire));
+
+	if (count)
+	{
+	    pthread_mutex_lock (&_reclaimer.flush_lock);
+	    atomic_fetch_add_explicit (&_reclaimer.freed, count, memory_order_relaxed);
+	    pthread_cond_broadcast (&_reclaimer.flushed);
+	    pthread_mutex_unlock (&_reclaimer.flush_lock);
+	}
+
+	if (atomic_load_explicit (&_reclaimer.stop, memory_order_acquire) && !atomic_load (&_reclaimer.head))
+	{
+	    return NULL;
+	}
+    }
+}
+
+static bool _start ()
+{
+    bool running;
+
+    pthread_mutex_lock (&_reclaimer.lock);
+
+    if (!atomic_load (&_reclaimer.running))
+    {
+	if (0 != sem_init (&_reclaimer.wake, 0, 0))
+	{
+	    perror ("sem_init");
+	}
+	else if (0 != pthread_create (&_reclaimer.thread, NULL, _reclaim_thread, NULL))
+	{
+	    perror ("pthread_create");
+	    sem_destroy (&_reclaimer.wake);
+	}
+	else
+	{
+	    atomic_store (&_reclaimer.running, true);
+	}
+    }
+
+    running = atomic_load (&_reclaimer.running);
+
+    pthread_mutex_unlock (&_reclaimer.lock);
+
+    return running;
+}
+
+void json_value_clear_deferred (json_value * value)
+{
+    json_reclaim_node * node = malloc (sizeof(*node));
+
+    if (!node)
+    {
+	json_value_clear (value);
+	return;
+    }
+
+    node->value = *value;
+    *value = (json_value){0};
+
+    // Stopping waits for pushes that saw the reclaimer running, so none are stranded on the list
+    while (true)
+    {
+	atomic_fetch_add (&_reclaimer.pushing, 1);
+
+	if (atomic_load (&_reclaimer.running))
+	{
+	    break;
+	}
+
+	atomic_fetch_sub (&_reclaimer.pushing, 1);
+
+	if (!_start ())
+	{
+	    json_value_clear (&node->value);
+	    free (node);
+	    return;
+	}
+    }
+
+    node->next = atomic_load_explicit (&_reclaimer.head, memory_order_relaxed);
+
+    while (!atomic_compare_exchange_weak_explicit (&_reclaimer.head, &node->next, node, memory_order_release, memory_order_relaxed))
+    {
+    }
+
+    atomic_fetch_add_explicit (&_reclaimer.queued, 1, memory_order_relaxed);
+    atomic_fetch_sub (&_reclaimer.pushing, 1);
+
+    sem_post (&_reclaimer.wake);
+}
+
+void json_value_free_deferred (json_value * value)
+{
+    if (!value)
+    {
+	return;
+    }
+
+    json_value_clear_deferred (value);
+    free (value);
+}
+
+void json_reclaim_flush (void)
+{
+    size_t target = atomic_load (&_reclaimer.queued);
+
+    pthread_mutex_lock (&_reclaimer.flush_lock);
+
+    while (atomic_load_explicit (&_reclaimer.freed, memory_order_relaxed) < target)
+    {
+	pthread_cond_wait (&_reclaimer.flushed, &_reclaimer.flush_lock);
+    }
+
+    pthread_mutex_unlock (&_reclaimer.flush_lock);
+}
+
+void json_reclaim_stop (void)
+{
+    pthread_mutex_lock (&_reclaimer.lock);
+
+    if (atomic_load (&_reclaimer.running))
+    {
+	atomic_store (&_reclaimer.running, false);
+
+	while (atomic_load (&_reclaimer.pushing))
+	{
+	    sched_yield ();
+	}
+
+	atomic_store_explicit (&_reclaimer.stop, true, memory_order_release);
+	sem_post (&_reclaimer.wake);
+	pthread_join (_reclaimer.thread, NULL);
+	atomic_store (&_reclaimer.stop, false);
+	sem_destroy (&_reclaimer.wake);
+    }
+
+    pthread_mutex_unlock (&_reclaimer.lock);
+}
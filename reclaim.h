@@ -0,0 +1,21 @@
+#ifndef FLAT_INCLUDES
+#include "def.h"
+#endif
+
+/*
+  Deferred destruction. json_value_clear_deferred and
+  json_value_free_deferred take ownership of a value's contents and hand
+  them to a background reclaimer thread through a lock free list, so the
+  calling thread pays for one small allocation instead of walking the
+  whole tree. The reclaimer starts with the first deferred value.
+
+  json_reclaim_flush waits until everything deferred before the call
+  has been freed. json_reclaim_stop frees whatever is still queued and
+  joins the reclaimer; a later deferred value starts it again. If the
+  reclaimer cannot be started, values are freed on the calling thread.
+*/
+
+void json_value_clear_deferred (json_value * value);
+void json_value_free_deferred (json_value * value);
+void json_reclaim_flush (void);
+void json_reclaim_stop (void);
@@ -0,0 +1,1007 @@
+#include "schema.h"
+#include "traverse.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+#define JSON_SCHEMA_NULL 1
+#define JSON_SCHEMA_BOOLEAN 2
+#define JSON_SCHEMA_NUMBER 4
+#define JSON_SCHEMA_INTEGER 8
+#define JSON_SCHEMA_STRING 16
+#define JSON_SCHEMA_ARRAY 32
+#define JSON_SCHEMA_OBJECT 64
+
+#define JSON_SCHEMA_NOT_REQUIRED SIZE_MAX
+
+typedef struct json_schema_constant json_schema_constant;
+struct json_schema_constant {
+    json_type type;
+    double number;
+    char * string;
+    size_t length;
+};
+
+typedef struct json_schema_property json_schema_property;
+struct json_schema_property {
+    char * key;
+    size_t key_length;
+    size_t required;
+    json_schema * schema;
+};
+
+struct json_schema {
+    bool constrained;
+    bool never;
+    unsigned types;
+    double minimum;
+    double maximum;
+    double exclusive_minimum;
+    double exclusive_maximum;
+    double multiple_of;
+    size_t min_length;
+    size_t max_length;
+    size_t min_items;
+    size_t max_items;
+    size_t min_properties;
+    size_t max_properties;
+    json_schema_constant * enums;
+    size_t enum_count;
+    bool has_constant;
+    json_schema_constant constant;
+    json_schema * items;
+    json_schema_property * properties;
+    size_t property_count;
+    size_t required_count;
+    json_schema * additional;
+};
+
+static const char * _unsupported[] = {
+    "$ref", "$dynamicRef", "allOf", "anyOf", "oneOf", "not", "if", "then", "else",
+    "pattern", "patternProperties", "propertyNames", "dependencies", "dependentRequired",
+    "dependentSchemas", "uniqueItems", "contains", "prefixItems", "additionalItems",
+    "unevaluatedItems", "unevaluatedProperties", NULL
+};
+
+static const struct { const char * name; unsigned bit; } _type_names[] = {
+    { "null", JSON_SCHEMA_NULL },
+    { "boolean", JSON_SCHEMA_BOOLEAN },
+    { "number", JSON_SCHEMA_NUMBER },
+    { "integer", JSON_SCHEMA_INTEGER },
+    { "string", JSON_SCHEMA_STRING },
+    { "array", JSON_SCHEMA_ARRAY },
+    { "object", JSON_SCHEMA_OBJECT },
+};
+
+static int _compare_key (const char * a, size_t a_length, const char * b, size_t b_length)
+{
+    int compare = memcmp (a, b, a_length < b_length ? a_length : b_length);
+
+    if (compare)
+    {
+	return compare;
+    }
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+static int _compare_properties (const void * a, const void * b)
+{
+    const json_schema_property * a_property = a;
+    const json_schema_property * b_property = b;
+
+    return _compare_key (a_property->key, a_property->key_length, b_property->key, b_property->key_length);
+}
+
+static void _clear (json_schema * schema)
+{
+    for (size_t i = 0; i < schema->enum_count; i++)
+    {
+	free (schema->enums[i].string);
+    }
+
+    for (size_t i = 0; i < schema->property_count; i++)
+    {
+	free (schema->properties[i].key);
+	json_schema_free (schema->properties[i].schema);
+    }
+
+    free (schema->constant.string);
+    free (schema->enums);
+    free (schema->properties);
+    json_schema_free (schema->items);
+    json_schema_free (schema->additional);
+}
+
+void json_schema_free (json_schema * schema)
+{
+    if (!schema)
+    {
+	return;
+    }
+
+    _clear (schema);
+    free (schema);
+}
+
+static bool _compile (json_schema * schema, const json_value * node);
+
+static json_schema * _compile_child (const json_value * node)
+{
+    json_schema * schema = calloc (1, sizeof(*schema));
+
+    if (!schema)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    if (!_compile (schema, node))
+    {
+	json_schema_free (schema);
+	return NULL;
+    }
+
+    return schema;
+}
+
+static bool _compile_number (json_schema * schema, double * output, const json_value * node, const char * keyword)
+{
+    const json_value * value = json_field (node, keyword);
+
+    if (!value)
+    {
+	return true;
+    }
+
+    if (value->type != JSON_NUMBER)
+    {
+	log_fatal ("Schema keyword %s should be a number", keyword);
+    }
+
+    *output = json_number (value);
+    schema->constrained = true;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _compile_count (json_schema * schema, size_t * output, const json_value * node, const char * keyword)
+{
+    const json_value * value = json_field (node, keyword);
+    double number;
+
+    if (!value)
+    {
+	return true;
+    }
+
+    number = value->type == JSON_NUMBER ? json_number (value) : -1;
+
+    if (!(number >= 0 && number == floor (number) && number < 18446744073709551616.0))
+    {
+	log_fatal ("Schema keyword %s should be a non-negative integer", keyword);
+    }
+
+    *output = (size_t) number;
+    schema->constrained = true;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _compile_type (json_schema * schema, const json_value * name)
+{
+    name = json_resolve (name);
+
+    if (name->type == JSON_STRING)
+    {
+	for (size_t i = 0; i < sizeof(_type_names) / sizeof(*_type_names); i++)
+	{
+	    if (0 == strcmp (name->string, _type_names[i].name))
+	    {
+		schema->types |= _type_names[i].bit;
+		return true;
+	    }
+	}
+    }
+
+    log_fatal ("Schema type should be one of null, boolean, number, integer, string, array or object");
+
+fail:
+    return false;
+}
+
+static bool _compile_constant (json_schema_constant * constant, const json_value * value)
+{
+    range_const_char string;
+
+    value = json_resolve (value);
+
+    if (value->type == JSON_ARRAY || value->type == JSON_OBJECT)
+    {
+	log_fatal ("Only null, boolean, number and string values are supported in enum and const");
+    }
+
+    *constant = (json_schema_constant){ .type = value->type };
+
+    if (value->type == JSON_NUMBER)
+    {
+	constant->number = json_number (value);
+    }
+    else if (value->type == JSON_STRING)
+    {
+	string = json_string_range (value);
+	constant->length = range_count (string);
+	constant->string = malloc (constant->length + 1);
+
+	if (!constant->string)
+	{
+	    perror ("malloc");
+	    return false;
+	}
+
+	memcpy (constant->string, string.begin, constant->length + 1);
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _compile_enum (json_schema * schema, const json_value * node)
+{
+    const json_value * values = json_field (node, "enum");
+    const json_value * constant = json_field (node, "const");
+
+    // const and enum are separate checks that must both hold
+    if (constant)
+    {
+	schema->constrained = schema->has_constant = true;
+
+	if (!_compile_constant (&schema->constant, constant))
+	{
+	    return false;
+	}
+    }
+
+    if (values && values->type != JSON_ARRAY)
+    {
+	log_fatal ("Schema keyword enum should be an array");
+    }
+
+    if (values && !values->count)
+    {
+	schema->constrained = schema->never = true;
+    }
+
+    if (!values || !values->count)
+    {
+	return true;
+    }
+
+    schema->enums = calloc (values->count, sizeof(*schema->enums));
+
+    if (!schema->enums)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    schema->constrained = true;
+
+    if (json_is_packed (values))
+    {
+	json_number_array numbers = json_packed_numbers (values);
+
+	for (size_t i = 0; i < numbers.count; i++)
+	{
+	    schema->enums[schema->enum_count++] = (json_schema_constant){ .type = JSON_NUMBER, .number = json_number_at (&numbers, i) };
+	}
+    }
+    else
+    {
+	for (size_t i = 0; i < values->count; i++)
+	{
+	    if (!_compile_constant (schema->enums + schema->enum_count, values->elements + i))
+	    {
+		return false;
+	    }
+
+	    schema->enum_count++;
+	}
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+static json_schema_property * _add_property (json_schema * schema, const range_const_char * key)
+{
+    json_schema_property * properties = realloc (schema->properties, (schema->property_count + 1) * sizeof(*properties));
+    json_schema_property * property;
+
+    if (!properties)
+    {
+	perror ("realloc");
+	return NULL;
+    }
+
+    schema->properties = properties;
+    property = properties + schema->property_count;
+    *property = (json_schema_property){ .key_length = range_count (*key), .required = JSON_SCHEMA_NOT_REQUIRED };
+    property->key = malloc (property->key_length + 1);
+
+    if (!property->key)
+    {
+	perror ("malloc");
+	return NULL;
+    }
+
+    memcpy (property->key, key->begin, property->key_length);
+    property->key[property->key_length] = '\0';
+    schema->property_count++;
+
+    return property;
+}
+
+static bool _compile_properties (json_schema * schema, const json_value * node)
+{
+    const json_value * properties = json_field (node, "properties");
+    const json_value * required = json_field (node, "required");
+    const json_value * additional = json_field (node, "additionalProperties");
+    json_schema_property * property;
+    json_field_iterator fields;
+    range_const_char key;
+    size_t i;
+
+    if (properties)
+    {
+	if (properties->type != JSON_OBJECT)
+	{
+	    log_fatal ("Schema keyword properties should be an object");
+	}
+
+	schema->constrained = true;
+	fields = json_field_iterator (properties);
+
+	while (json_field_next (&fields))
+	{
+	    property = _add_property (schema, &fields.key);
+
+	    if (!property || !(property->schema = _compile_child (fields.value)))
+	    {
+		return false;
+	    }
+	}
+    }
+
+    if (required)
+    {
+	if (required->type != JSON_ARRAY || json_is_packed (required))
+	{
+	    log_fatal ("Schema keyword required should be an array of strings");
+	}
+
+	schema->constrained = true;
+
+	for (size_t n = 0; n < required->count; n++)
+	{
+	    if (json_resolve (required->elements + n)->type != JSON_STRING)
+	    {
+		log_fatal ("Schema keyword required should be an array of strings");
+	    }
+
+	    key = json_string_range (required->elements + n);
+
+	    for (i = 0; i < schema->property_count; i++)
+	    {
+		if (0 == _compare_key (key.begin, range_count (key), schema->properties[i].key, schema->properties[i].key_length))
+		{
+		    break;
+		}
+	    }
+
+	    if (i == schema->property_count && !_add_property (schema, &key))
+	    {
+		return false;
+	    }
+
+	    if (schema->properties[i].required == JSON_SCHEMA_NOT_REQUIRED)
+	    {
+		schema->properties[i].required = schema->required_count++;
+	    }
+	}
+    }
+
+    if (schema->property_count)
+    {
+	qsort (schema->properties, schema->property_count, sizeof(*schema->properties), _compare_properties);
+    }
+
+    if (additional)
+    {
+	schema->constrained = true;
+	schema->additional = _compile_child (additional);
+
+	if (!schema->additional)
+	{
+	    return false;
+	}
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _compile (json_schema * schema, const json_value * node)
+{
+    const json_value * type;
+    const json_value * items;
+
+    *schema = (json_schema){
+	.minimum = -INFINITY,
+	.maximum = INFINITY,
+	.exclusive_minimum = -INFINITY,
+	.exclusive_maximum = INFINITY,
+	.max_length = SIZE_MAX,
+	.max_items = SIZE_MAX,
+	.max_properties = SIZE_MAX,
+    };
+
+    node = json_resolve (node);
+
+    if (node->type == JSON_TRUE)
+    {
+	return true;
+    }
+
+    if (node->type == JSON_FALSE)
+    {
+	schema->constrained = schema->never = true;
+	return true;
+    }
+
+    if (node->type != JSON_OBJECT)
+    {
+	log_fatal ("A schema should be an object, true or false");
+    }
+
+    for (const char ** keyword = _unsupported; *keyword; keyword++)
+    {
+	if (json_field (node, *keyword))
+	{
+	    log_fatal ("Schema keyword %s is not supported", *keyword);
+	}
+    }
+
+    type = json_field (node, "type");
+
+    if (type)
+    {
+	schema->constrained = true;
+
+	if (type->type == JSON_ARRAY && !json_is_packed (type))
+	{
+	    for (size_t i = 0; i < type->count; i++)
+	    {
+		if (!_compile_type (schema, type->elements + i))
+		{
+		    return false;
+		}
+	    }
+	}
+	else if (!_compile_type (schema, type))
+	{
+	    return false;
+	}
+    }
+
+    items = json_field (node, "items");
+
+    if (items)
+    {
+	schema->constrained = true;
+	schema->items = _compile_child (items);
+
+	if (!schema->items)
+	{
+	    return false;
+	}
+    }
+
+    if (!_compile_enum (schema, node)
+	|| !_compile_number (schema, &schema->minimum, node, "minimum")
+	|| !_compile_number (schema, &schema->maximum, node, "maximum")
+	|| !_compile_number (schema, &schema->exclusive_minimum, node, "exclusiveMinimum")
+	|| !_compile_number (schema, &schema->exclusive_maximum, node, "exclusiveMaximum")
+	|| !_compile_number (schema, &schema->multiple_of, node, "multipleOf")
+	|| !_compile_count (schema, &schema->min_length, node, "minLength")
+	|| !_compile_count (schema, &schema->max_length, node, "maxLength")
+	|| !_compile_count (schema, &schema->min_items, node, "minItems")
+	|| !_compile_count (schema, &schema->max_items, node, "maxItems")
+	|| !_compile_count (schema, &schema->min_properties, node, "minProperties")
+	|| !_compile_count (schema, &schema->max_properties, node, "maxProperties")
+	|| !_compile_properties (schema, node))
+    {
+	return false;
+    }
+
+    if (json_field (node, "multipleOf") && !(schema->multiple_of > 0))
+    {
+	log_fatal ("Schema keyword multipleOf should be positive");
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+json_schema * json_schema_compile (const json_value * document)
+{
+    return _compile_child (document);
+}
+
+static bool _violation (json_validator * validator, const char * at, const char * reason)
+{
+    validator->offset = at - validator->begin;
+    validator->reason = reason;
+
+    *window_push (validator->path) = '\0';
+    validator->path.region.end--;
+
+    return false;
+}
+
+static void _push_key (window_char * path, const range_const_char * key)
+{
+    const char * c;
+
+    *window_push (*path) = '/';
+
+    for_range (c, *key)
+    {
+	if (*c == '~' || *c == '/')
+	{
+	    *window_push (*path) = '~';
+	    *window_push (*path) = *c == '~' ? '0' : '1';
+	}
+	else
+	{
+	    *window_push (*path) = *c;
+	}
+    }
+}
+
+static void _push_index (window_char * path, size_t index)
+{
+    char digits[24];
+    int length = snprintf (digits, sizeof(digits), "/%zu", index);
+
+    for (int i = 0; i < length; i++)
+    {
+	*window_push (*path) = digits[i];
+    }
+}
+
+static bool _allows (const json_schema * schema, unsigned type)
+{
+    return !schema->types || (schema->types & type);
+}
+
+static bool _in_constants (const json_schema_constant * constants, size_t count, json_type type, double number, const range_const_char * string)
+{
+    const json_schema_constant * constant;
+
+    for (size_t i = 0; i < count; i++)
+    {
+	constant = constants + i;
+
+	if (constant->type != type)
+	{
+	    continue;
+	}
+
+	if (type == JSON_NUMBER ? constant->number == number
+	    : type == JSON_STRING ? constant->length == (size_t) range_count (*string) && 0 == memcmp (constant->string, string->begin, constant->length)
+	    : true)
+	{
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+static bool _restricts_values (const json_schema * schema)
+{
+    return schema->has_constant || schema->enum_count;
+}
+
+static bool _is_allowed (const json_schema * schema, json_type type, double number, const range_const_char * string)
+{
+    return (!schema->has_constant || _in_constants (&schema->constant, 1, type, number, string))
+	&& (!schema->enum_count || _in_constants (schema->enums, schema->enum_count, type, number, string));
+}
+
+static bool _check (json_validator * validator, const json_schema * schema, range_const_char * input);
+
+static bool _check_number (json_validator * validator, const json_schema * schema, double number, const char * at)
+{
+    bool integral = isfinite (number) && number == floor (number);
+    double quotient;
+
+    if (schema->types && !(schema->types & JSON_SCHEMA_NUMBER) && !(integral && (schema->types & JSON_SCHEMA_INTEGER)))
+    {
+	return _violation (validator, at, "has the wrong type");
+    }
+
+    if (number < schema->minimum || number <= schema->exclusive_minimum)
+    {
+	return _violation (validator, at, "is below the minimum");
+    }
+
+    if (number > schema->maximum || number >= schema->exclusive_maximum)
+    {
+	return _violation (validator, at, "is above the maximum");
+    }
+
+    if (schema->multiple_of > 0)
+    {
+	quotient = number / schema->multiple_of;
+
+	if (fabs (quotient - nearbyint (quotient)) > 1e-9 * fmax (1, fabs (quotient)))
+	{
+	    return _violation (validator, at, "is not a multiple of multipleOf");
+	}
+    }
+
+    if (!_is_allowed (schema, JSON_NUMBER, number, NULL))
+    {
+	return _violation (validator, at, "is not one of the allowed values");
+    }
+
+    return true;
+}
+
+static bool _check_string (json_validator * validator, const json_schema * schema, const char * at)
+{
+    const range_const_char * string = &validator->context.text.region.alias_const;
+    size_t length = 0;
+    const char * c;
+
+    if (!_allows (schema, JSON_SCHEMA_STRING))
+    {
+	return _violation (validator, at, "has the wrong type");
+    }
+
+    if (schema->min_length || schema->max_length != SIZE_MAX)
+    {
+	// Lengths are in code points, so continuation bytes are not counted
+	for_range (c, *string)
+	{
+	    length += (*c & 0xC0) != 0x80;
+	}
+
+	if (length < schema->min_length)
+	{
+	    return _violation (validator, at, "is too short");
+	}
+
+	if (length > schema->max_length)
+	{
+	    return _violation (validator, at, "is too long");
+	}
+    }
+
+    if (!_is_allowed (schema, JSON_STRING, 0, string))
+    {
+	return _violation (validator, at, "is not one of the allowed values");
+    }
+
+    return true;
+}
+
+static bool _check_array (json_validator * validator, const json_schema * schema, range_const_char * input)
+{
+    const char * at = input->begin;
+    size_t mark = range_count (validator->path.region);
+    bool constrained = schema->items && schema->items->constrained;
+    size_t count = 0;
+
+    if (!_allows (schema, JSON_SCHEMA_ARRAY))
+    {
+	return _violation (validator, at, "has the wrong type");
+    }
+
+    input->begin++;
+
+    if (!json_scan_punctuation (input, ']'))
+    {
+	while (true)
+	{
+	    if (constrained)
+	    {
+		_push_index (&validator->path, count);
+	    }
+
+	    if (!_check (validator, schema->items, input))
+	    {
+		return false;
+	    }
+
+	    validator->path.region.end = validator->path.region.begin + mark;
+	    count++;
+
+	    if (json_scan_punctuation (input, ']'))
+	    {
+		break;
+	    }
+
+	    if (!json_scan_punctuation (input, ','))
+	    {
+		return _violation (validator, at, "is malformed");
+	    }
+	}
+    }
+
+    if (count < schema->min_items)
+    {
+	return _violation (validator, at, "has too few items");
+    }
+
+    if (count > schema->max_items)
+    {
+	return _violation (validator, at, "has too many items");
+    }
+
+    if (_restricts_values (schema))
+    {
+	return _violation (validator, at, "is not one of the allowed values");
+    }
+
+    return true;
+}
+
+static const json_schema_property * _find (const json_schema * schema, const range_const_char * key)
+{
+    size_t low = 0;
+    size_t high = schema->property_count;
+    size_t middle;
+    int compare;
+
+    while (low < high)
+    {
+	middle = low + (high - low) / 2;
+	compare = _compare_key (key->begin, range_count (*key), schema->properties[middle].key, schema->properties[middle].key_length);
+
+	if (compare == 0)
+	{
+	    return schema->properties + middle;
+	}
+
+	if (compare < 0)
+	{
+	    high = middle;
+	}
+	else
+	{
+	    low = middle + 1;
+	}
+    }
+
+    return NULL;
+}
+
+static bool _check_object (json_validator * validator, const json_schema * schema, range_const_char * input)
+{
+    const char * at = input->begin;
+    size_t mark = range_count (validator->path.region);
+    size_t seen = range_count (validator->seen.region);
+    const json_schema_property * property;
+    const json_schema * child;
+    size_t count = 0;
+
+    if (!_allows (schema, JSON_SCHEMA_OBJECT))
+    {
+	return _violation (validator, at, "has the wrong type");
+    }
+
+    for (size_t i = 0; i < schema->required_count; i++)
+    {
+	*window_push (validator->seen) = 0;
+    }
+
+    input->begin++;
+
+    if (!json_scan_punctuation (input, '}'))
+    {
+	while (true)
+	{
+	    if (!json_scan_string (&validator->context, input) || !json_scan_punctuation (input, ':'))
+	    {
+		return _violation (validator, at, "is malformed");
+	    }
+
+	    property = _find (schema, &validator->context.text.region.alias_const);
+	    // Names only listed in required have no schema of their own and fall under additionalProperties
+	    child = property && property->schema ? property->schema : schema->additional;
+
+	    if (property && property->required != JSON_SCHEMA_NOT_REQUIRED)
+	    {
+		validator->seen.region.begin[seen + property->required] = 1;
+	    }
+
+	    if (child && child->constrained)
+	    {
+		_push_key (&validator->path, &validator->context.text.region.alias_const);
+	    }
+
+	    if (!_check (validator, child, input))
+	    {
+		return false;
+	    }
+
+	    validator->path.region.end = validator->path.region.begin + mark;
+	    count++;
+
+	    if (json_scan_punctuation (input, '}'))
+	    {
+		break;
+	    }
+
+	    if (!json_scan_punctuation (input, ','))
+	    {
+		return _violation (validator, at, "is malformed");
+	    }
+	}
+    }
+
+    if (count < schema->min_properties)
+    {
+	return _violation (validator, at, "has too few properties");
+    }
+
+    if (count > schema->max_properties)
+    {
+	return _violation (validator, at, "has too many properties");
+    }
+
+    for (size_t i = 0; i < schema->property_count; i++)
+    {
+	property = schema->properties + i;
+
+	if (property->required != JSON_SCHEMA_NOT_REQUIRED && !validator->seen.region.begin[seen + property->required])
+	{
+	    _push_key (&validator->path, &(range_const_char){ .begin = property->key, .end = property->key + property->key_length });
+	    return _violation (validator, at, "is required but missing");
+	}
+    }
+
+    validator->seen.region.end = validator->seen.region.begin + seen;
+
+    if (_restricts_values (schema))
+    {
+	return _violation (validator, at, "is not one of the allowed values");
+    }
+
+    return true;
+}
+
+static bool _check (json_validator * validator, const json_schema * schema, range_const_char * input)
+{
+    json_type type = json_scan_next (input);
+    const char * at = input->begin;
+    double number;
+
+    if (!schema || !schema->constrained)
+    {
+	return json_skip_value (&validator->context, input) || _violation (validator, at, "is malformed");
+    }
+
+    if (schema->never)
+    {
+	return _violation (validator, at, "is not allowed by the schema");
+    }
+
+    switch (type)
+    {
+    case JSON_NULL:
+    case JSON_TRUE:
+    case JSON_FALSE:
+	if (!json_skip_value (&validator->context, input))
+	{
+	    return _violation (validator, at, "is malformed");
+	}
+
+	if (!_allows (schema, type == JSON_NULL ? JSON_SCHEMA_NULL : JSON_SCHEMA_BOOLEAN))
+	{
+	    return _violation (validator, at, "has the wrong type");
+	}
+
+	if (!_is_allowed (schema, type, 0, NULL))
+	{
+	    return _violation (validator, at, "is not one of the allowed values");
+	}
+
+	return true;
+
+    case JSON_NUMBER:
+	if (!json_scan_number (&number, input))
+	{
+	    return _violation (validator, at, "is malformed");
+	}
+
+	return _check_number (validator, schema, number, at);
+
+    case JSON_STRING:
+	if (!json_scan_string (&validator->context, input))
+	{
+	    return _violation (validator, at, "is malformed");
+	}
+
+	return _check_string (validator, schema, at);
+
+    case JSON_ARRAY:
+	return _check_array (validator, schema, input);
+
+    case JSON_OBJECT:
+	return _check_object (validator, schema, input);
+
+    default:
+	return _violation (validator, at, "is malformed");
+    }
+}
+
+bool json_schema_check (json_validator * validator, const json_schema * schema, range_const_char * input)
+{
+    validator->begin = input->begin;
+    validator->path.region.end = validator->path.region.begin;
+    validator->seen.region.end = validator->seen.region.begin;
+    validator->offset = 0;
+    validator->reason = NULL;
+
+    return _check (validator, schema, input);
+}
+
+bool json_schema_validate (json_validator * validator, const json_schema * schema, const range_const_char * input)
+{
+    range_const_char text = *input;
+
+    if (!json_schema_check (validator, schema, &text))
+    {
+	return false;
+    }
+
+    if (json_scan_next (&text) != JSON_BADTYPE || text.begin != text.end)
+    {
+	return _violation (validator, text.begin, "is followed by more input");
+    }
+
+    return true;
+}
+
+void json_validator_clear (json_validator * validator)
+{
+    json_parser_context_clear (&validator->context);
+    free (validator->path.alloc.begin);
+    free (validator->seen.alloc.begin);
+    validator->path = (window_char){0};
+    validator->seen = (window_char){0};
+}
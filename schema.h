@@ -0,0 +1,51 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "def.h"
+#include "parse.h"
+#include "../window/def.h"
+#endif
+
+/*
+  A subset of JSON Schema, compiled once from a parsed schema document
+  and checked against raw input in a single scan. Values are never built
+  into json_values: each one is checked as it is read, and subtrees the
+  schema says nothing about are skipped.
+
+  Supported keywords are type (including integer), enum, const,
+  minimum, maximum, exclusiveMinimum, exclusiveMaximum, multipleOf,
+  minLength, maxLength, minItems, maxItems, items, properties,
+  required, additionalProperties, minProperties and maxProperties, and
+  the schemas true and false. Keywords that would change the meaning of
+  a schema but are not supported, such as $ref or anyOf, are rejected
+  when compiling; annotations such as title are ignored.
+
+  Checking stops at the first violation. The validator then holds its
+  byte offset from the start of the input, the JSON pointer of the
+  offending value and a short reason. Malformed input inside a subtree
+  the schema does not constrain is reported at the pointer of the
+  nearest constrained value. json_schema_check reads a single value and
+  advances past it, for streams of records; its offsets count from
+  where that value's input began. A validator can be reused for any
+  number of documents or schemas.
+*/
+
+typedef struct json_schema json_schema;
+
+typedef struct json_validator json_validator;
+struct json_validator {
+    json_parser_context context;
+    window_char path;
+    window_char seen;
+    const char * begin;
+    size_t offset;
+    const char * reason;
+};
+
+json_schema * json_schema_compile (const json_value * document);
+void json_schema_free (json_schema * schema);
+
+bool json_schema_validate (json_validator * validator, const json_schema * schema, const range_const_char * input);
+bool json_schema_check (json_validator * validator, const json_schema * schema, range_const_char * input); // one value, advances input
+void json_validator_clear (json_validator * validator);
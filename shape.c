@@ -0,0 +1,200 @@
+#include "shape.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+json_shape_table * json_shape_table_new ()
+{
+    json_shape_table * table = calloc (1, sizeof(*table));
+
+    if (!table)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    atomic_init (&table->references, 1);
+    table->root.table = table;
+
+    return table;
+}
+
+void json_shape_table_retain (json_shape_table * table)
+{
+    atomic_fetch_add_explicit (&table->references, 1, memory_order_relaxed);
+}
+
+static void _free_shape (json_shape * shape)
+{
+    // Earlier keys belong to the ancestors of the shape, only the last one is its own
+    free ((char*) shape->keys[shape->count - 1]);
+    free (shape->keys);
+    free (shape->key_lengths);
+    free (shape);
+}
+
+void json_shape_table_release (json_shape_table * table)
+{
+    json_shape * shape;
+    json_shape * next;
+
+    if (!table || 1 != atomic_fetch_sub_explicit (&table->references, 1, memory_order_acq_rel))
+    {
+	return;
+    }
+
+    for (shape = table->root.allocated; shape; shape = next)
+    {
+	next = shape->allocated;
+	_free_shape (shape);
+    }
+
+    free (table->slots);
+    free (table);
+}
+
+bool json_shape_slot (uint32_t * slot, const json_shape * shape, const char * key, size_t key_length)
+{
+    for (uint32_t i = 0; i < shape->count; i++)
+    {
+	if (shape->key_lengths[i] == key_length && 0 == memcmp (shape->keys[i], key, key_length))
+	{
+	    *slot = i;
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+static uint64_t _hash_transition (const json_shape * parent, const char * key, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325 ^ (uint64_t) (uintptr_t) parent;
+
+    while (length--)
+    {
+	hash = (hash ^ (uint8_t) *key++) * 0x100000001b3;
+    }
+
+    return hash ^ (hash >> 29);
+}
+
+static bool _grow_slots (json_shape_table * table)
+{
+    size_t count = table->slot_count ? table->slot_count * 2 : 64;
+    json_shape ** slots = calloc (count, sizeof(*slots));
+    json_shape * shape;
+    size_t i;
+
+    if (!slots)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    for (shape = table->root.allocated; shape; shape = shape->allocated)
+    {
+	i = _hash_transition (shape->parent, shape->keys[shape->count - 1], shape->key_lengths[shape->count - 1]) & (count - 1);
+
+	while (slots[i])
+	{
+	    i = (i + 1) & (count - 1);
+	}
+
+	slots[i] = shape;
+    }
+
+    free (table->slots);
+    table->slots = slots;
+    table->slot_count = count;
+
+    return true;
+}
+
+json_shape * json_shape_transition (json_shape * shape, const range_const_char * key)
+{
+    json_shape_table * table = shape->table;
+    size_t length = range_count (*key);
+    json_shape * child;
+    char * copy;
+    uint32_t slot;
+    size_t i = 0;
+
+    // A child only exists for a key its parent lacks, so a hit needs no duplicate check
+    if (table->slot_count)
+    {
+	for (i = _hash_transition (shape, key->begin, length) & (table->slot_count - 1); (child = table->slots[i]); i = (i + 1) & (table->slot_count - 1))
+	{
+	    if (child->parent == shape && child->key_lengths[shape->count] == length && 0 == memcmp (child->keys[shape->count], key->begin, length))
+	    {
+		return child;
+	    }
+	}
+    }
+
+    if (shape->count == JSON_SHAPE_MAX_KEYS || table->count == JSON_SHAPE_MAX_SHAPES || length > UINT32_MAX
+	|| json_shape_slot (&slot, shape, key->begin, length))
+    {
+	return NULL;
+    }
+
+    if ((table->count + 1) * 2 > table->slot_count)
+    {
+	if (!_grow_slots (table))
+	{
+	    return NULL;
+	}
+
+	for (i = _hash_transition (shape, key->begin, length) & (table->slot_count - 1); table->slots[i]; i = (i + 1) & (table->slot_count - 1))
+	{
+	}
+    }
+
+    child = calloc (1, sizeof(*child));
+    copy = malloc (length + 1);
+
+    if (child)
+    {
+	child->keys = malloc ((shape->count + 1) * sizeof(*child->keys));
+	child->key_lengths = malloc ((shape->count + 1) * sizeof(*child->key_lengths));
+    }
+
+    if (!child || !copy || !child->keys || !child->key_lengths)
+    {
+	perror ("malloc");
+
+	if (child)
+	{
+	    free (child->keys);
+	    free (child->key_lengths);
+	}
+
+	free (child);
+	free (copy);
+	return NULL;
+    }
+
+    memcpy (copy, key->begin, length);
+    copy[length] = '\0';
+
+    if (shape->count)
+    {
+	memcpy (child->keys, shape->keys, shape->count * sizeof(*child->keys));
+	memcpy (child->key_lengths, shape->key_lengths, shape->count * sizeof(*child->key_lengths));
+    }
+
+    child->keys[shape->count] = copy;
+    child->key_lengths[shape->count] = length;
+    child->count = shape->count + 1;
+    child->table = table;
+    child->parent = shape;
+
+    child->allocated = table->root.allocated;
+    table->root.allocated = child;
+
+    table->slots[i] = child;
+    table->count++;
+
+    return child;
+}
@@ -0,0 +1,61 @@
+#ifndef FLAT_INCLUDES
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "def.h"
+#endif
+
+/*
+  Object shapes, for parsers with share_shapes set. A shape is an
+  ordered list of keys. Shapes form a transition tree rooted at the
+  empty shape, where each child adds one key to its parent, so every
+  object with the same keys in the same order ends at the same shape.
+  Such objects are stored as a json_shaped: a pointer to the shape and
+  a dense array of values in key order, with no hash table.
+
+  All shapes reached from one parser context live in one
+  json_shape_table. The table is reference counted by the context and
+  by every shaped object, so objects outlive the context that parsed
+  them. Transitions are only added by the parsing thread; shaped objects
+  may be read and freed from any thread.
+
+  Transitions are found through a hash of the parent shape and the
+  added key. A table holds at most JSON_SHAPE_MAX_SHAPES shapes, so a
+  long running parser that keeps meeting new keys stops growing it;
+  objects that would need a new shape past that point are read into
+  ordinary tables.
+*/
+
+#define JSON_SHAPE_MAX_KEYS 64
+#define JSON_SHAPE_MAX_SHAPES 4096
+
+typedef struct json_shape_table json_shape_table;
+
+struct json_shape {
+    json_shape_table * table;
+    json_shape * parent;
+    json_shape * allocated;
+    uint32_t count;
+    const char ** keys;
+    uint32_t * key_lengths;
+};
+
+struct json_shaped {
+    json_shape * shape;
+    json_value values[];
+};
+
+struct json_shape_table {
+    atomic_size_t references;
+    json_shape root;
+    size_t count;
+    size_t slot_count;
+    json_shape ** slots;
+};
+
+json_shape_table * json_shape_table_new ();
+void json_shape_table_retain (json_shape_table * table);
+void json_shape_table_release (json_shape_table * table);
+
+json_shape * json_shape_transition (json_shape * shape, const range_const_char * key);
+bool json_shape_slot (uint32_t * slot, const json_shape * shape, const char * key, size_t key_length);
@@ -0,0 +1,382 @@
+#include "shared.h"
+#include "traverse.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../log/log.h"
+
+void json_freeze (json_value * value)
+{
+    json_value * element;
+    json_link ** bucket;
+    json_link * link;
+    json_shared * shared;
+
+    switch (value->type)
+    {
+    case JSON_ARRAY:
+	if (json_is_packed (value))
+	{
+	    break;
+	}
+	
+	for_range (element, json_elements (value))
+	{
+	    json_freeze (element);
+	}
+	break;
+
+    case JSON_OBJECT:
+	if (value->flags & JSON_FLAG_SHAPED)
+	{
+	    for (uint32_t i = 0; i < value->count; i++)
+	    {
+		json_freeze (value->shaped->values + i);
+	    }
+	    break;
+	}
+
+	for_range (bucket, *value->object)
+	{
+	    for (link = *bucket; link; link = link->peer)
+	    {
+		json_freeze (&link->child.value);
+	    }
+	}
+	break;
+
+    case JSON_STRING:
+	break;
+
+    case JSON_NUMBER:
+	json_number (value);
+	return;
+
+    default:
+	return;
+    }
+
+    shared = malloc (sizeof(*shared));
+
+    if (!shared)
+    {
+	perror ("malloc");
+	return;
+    }
+
+    atomic_init (&shared->references, 1);
+    atomic_init (&shared->hash, 0);
+    shared->value = *value;
+
+    value->type = JSON_SHARED;
+    value->shared = shared;
+}
+
+static bool _copy_array (json_value * output, const json_value * input)
+{
+    json_array array;
+
+    if (!input->count)
+    {
+	return true;
+    }
+
+    if (json_is_packed (input))
+    {
+	output->doubles = malloc (input->count * sizeof(*input->doubles));
+
+	if (!output->doubles)
+	{
+	    perror ("malloc");
+	    return false;
+	}
+
+	memcpy (output->doubles, input->doubles, input->count * sizeof(*input->doubles));
+	output->flags = input->flags;
+	output->count = input->count;
+	return true;
+    }
+
+    output->elements = calloc (input->count, sizeof(*output->elements));
+
+    if (!output->elements)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    output->count = input->count;
+
+    for (size_t i = 0; i < input->count; i++)
+    {
+	if (!json_clone (output->elements + i, input->elements + i))
+	{
+	    array = json_elements (output);
+	    json_array_clear (&array);
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+static json_object * _copy_object (const json_object * input)
+{
+    json_link ** bucket;
+    json_link * link;
+    json_pair * pair;
+
+    json_object * output = calloc (1, sizeof(*output));
+
+    if (!output)
+    {
+	perror ("calloc");
+	return NULL;
+    }
+
+    for_range (bucket, *input)
+    {
+	for (link = *bucket; link; link = link->peer)
+	{
+	    pair = json_include_range (output, &link->child.query.key.range);
+
+	    if (!json_clone (&pair->value, &link->child.value))
+	    {
+		json_object_clear (output);
+		free (output);
+		return NULL;
+	    }
+	}
+    }
+
+    return output;
+}
+
+static bool _copy_shaped (json_value * output, const json_value * input)
+{
+    json_shaped * shaped = malloc (sizeof(*shaped) + input->count * sizeof(*shaped->values));
+
+    if (!shaped)
+    {
+	perror ("malloc");
+	return false;
+    }
+
+    for (uint32_t i = 0; i < input->count; i++)
+    {
+	if (!json_clone (shaped->values + i, input->shaped->values + i))
+	{
+	    while (i--)
+	    {
+		json_value_clear (shaped->values + i);
+	    }
+
+	    free (shaped);
+	    return false;
+	}
+    }
+
+    shaped->shape = input->shaped->shape;
+    json_shape_table_retain (shaped->shape->table);
+
+    output->flags = JSON_FLAG_SHAPED;
+    output->shaped = shaped;
+    output->count = input->count;
+
+    return true;
+}
+
+bool json_clone (json_value * output, const json_value * input)
+{
+    *output = (json_value){ .type = input->type };
+
+    switch (input->type)
+    {
+    case JSON_SHARED:
+	atomic_fetch_add_explicit (&input->shared->references, 1, memory_order_relaxed);
+	output->shared = input->shared;
+	return true;
+
+    case JSON_STRING:
+	output->string = malloc (input->count + 1);
+
+	if (!output->string)
+	{
+	    perror ("malloc");
+	    goto fail;
+	}
+
+	memcpy (output->string, input->string, input->count + 1);
+	output->count = input->count;
+
+	return true;
+
+    case JSON_ARRAY:
+	if (!_copy_array (output, input))
+	{
+	    goto fail;
+	}
+	return true;
+
+    case JSON_OBJECT:
+	if (input->flags & JSON_FLAG_SHAPED)
+	{
+	    if (!_copy_shaped (output, input))
+	    {
+		goto fail;
+	    }
+	    return true;
+	}
+
+	output->object = _copy_object (input->object);
+
+	if (!output->object)
+	{
+	    goto fail;
+	}
+
+	return true;
+
+    case JSON_NUMBER:
+	*output = *input;
+
+	// The copy goes back to plain text rather than sharing the box
+	if (input->flags & JSON_FLAG_NUMBER_BOXED)
+	{
+	    output->flags &= ~JSON_FLAG_NUMBER_BOXED;
+	    output->number_text = input->number_box->text;
+	}
+	return true;
+
+    default:
+	*output = *input;
+	return true;
+    }
+
+fail:
+    *output = (json_value){0};
+    return false;
+}
+
+json_value * json_thaw (json_value * value)
+{
+    json_shared * shared;
+    json_value copy;
+
+    if (value->type != JSON_SHARED)
+    {
+	return value;
+    }
+
+    shared = value->shared;
+
+    if (1 == atomic_load_explicit (&shared->references, memory_order_acquire))
+    {
+	*value = shared->value;
+	free (shared);
+	return value;
+    }
+
+    if (!json_clone (&copy, &shared->value))
+    {
+	return NULL;
+    }
+
+    json_value_clear (value);
+
+    *value = copy;
+
+    return value;
+}
+
+json_value * json_thaw_key (json_value * object, const char * key)
+{
+    json_pair * pair;
+    uint32_t slot;
+
+    if (!json_thaw (object))
+    {
+	return NULL;
+    }
+
+    if (object->type != JSON_OBJECT)
+    {
+	log_fatal ("Cannot look up %s in a value of type %s", key, json_type_name (object->type));
+    }
+
+    if (object->flags & JSON_FLAG_SHAPED)
+    {
+	if (!json_shape_slot (&slot, object->shaped->shape, key, strlen (key)))
+	{
+	    return NULL;
+	}
+
+	return json_thaw (object->shaped->values + slot);
+    }
+
+    pair = json_lookup_string (object->object, key);
+
+    if (!pair)
+    {
+	return NULL;
+    }
+
+    return json_thaw (&pair->value);
+
+fail:
+    return NULL;
+}
+
+static bool _unpack_numbers (json_value * array)
+{
+    json_number_array numbers = json_packed_numbers (array);
+    json_value * elements = calloc (numbers.count, sizeof(*elements));
+
+    if (!elements)
+    {
+	perror ("calloc");
+	return false;
+    }
+
+    for (size_t i = 0; i < numbers.count; i++)
+    {
+	elements[i] = (json_value){ .type = JSON_NUMBER, .number = json_number_at (&numbers, i) };
+    }
+
+    free (array->doubles);
+    array->flags &= ~(JSON_FLAG_PACKED_DOUBLE | JSON_FLAG_PACKED_INT64);
+    array->elements = elements;
+
+    return true;
+}
+
+json_value * json_thaw_index (json_value * array, size_t index)
+{
+    if (!json_thaw (array))
+    {
+	return NULL;
+    }
+
+    if (array->type != JSON_ARRAY)
+    {
+	log_fatal ("Cannot index a value of type %s", json_type_name (array->type));
+    }
+
+    if (index >= array->count)
+    {
+	return NULL;
+    }
+
+    if (json_is_packed (array) && !_unpack_numbers (array))
+    {
+	return NULL;
+    }
+
+    return json_thaw (array->elements + index);
+
+fail:
+    return NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#endif
+
+/*
+  json_freeze moves a tree into reference counted JSON_SHARED boxes. A
+  frozen tree must not be modified, so every string and container in it
+  may be shared between documents and threads. Children of a frozen
+  container are themselves JSON_SHARED handles or scalars, use
+  json_resolve to look through them. Lazy numbers are converted while
+  freezing, since their first read would otherwise write to the tree.
+
+  json_clone makes a new reference to frozen values and copies only the
+  unfrozen parts of a tree. json_thaw makes a single value writable
+  again, copying it out of its box if the box is shared and leaving its
+  children shared, so a write copies only the path from the root to the
+  changed value.
+*/
+
+void json_freeze (json_value * value);
+bool json_clone (json_value * output, const json_value * input);
+json_value * json_thaw (json_value * value);
+json_value * json_thaw_key (json_value * object, const char * key);
+json_value * json_thaw_index (json_value * array, size_t index);
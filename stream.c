@@ -0,0 +1,150 @@
+#include "stream.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../window/alloc.h"
+#include "../log/log.h"
+
+static void _append (window_char * window, const char * begin, const char * end)
+{
+    while (begin < end)
+    {
+	*window_push (*window) = *begin++;
+    }
+}
+
+// Each line passed in includes its newline, so literals at the end of a line are followed by a byte
+static bool _parse_line (json_stream * stream, range_const_char * line)
+{
+    json_value value;
+    bool keep;
+
+    if (json_scan_next (line) == JSON_BADTYPE && line->begin == line->end)
+    {
+	return true;
+    }
+
+    if (!json_read_value (&value, stream->context, line))
+    {
+	log_fatal ("Failed to parse value %zu of the stream", stream->count);
+    }
+
+    if (json_scan_next (line) != JSON_BADTYPE || line->begin != line->end)
+    {
+	json_value_clear (&value);
+	log_fatal ("Value %zu of the stream is followed by more input on its line", stream->count);
+    }
+
+    stream->count++;
+
+    keep = stream->callback (stream->arg, &value);
+
+    json_value_clear (&value);
+
+    return keep;
+
+fail:
+    return false;
+}
+
+static bool _parse_lines (json_stream * stream, const range_const_char * text)
+{
+    range_const_char line = { .begin = text->begin };
+    const char * newline;
+
+    while (line.begin < text->end)
+    {
+	newline = memchr (line.begin, '\n', text->end - line.begin);
+	assert (newline);
+	line.end = newline + 1;
+
+	if (!_parse_line (stream, &line))
+	{
+	    return false;
+	}
+
+	line.begin = newline + 1;
+    }
+
+    return true;
+}
+
+static const char * _last_newline (const range_const_char * chunk)
+{
+    const char * i = chunk->end;
+
+    while (i > chunk->begin)
+    {
+	if (*--i == '\n')
+	{
+	    return i;
+	}
+    }
+
+    return NULL;
+}
+
+bool json_stream_feed (json_stream * stream, const range_const_char * chunk)
+{
+    const char * newline = _last_newline (chunk);
+    range_const_char lines = { .begin = chunk->begin };
+
+    if (!newline)
+    {
+	_append (&stream->pending, chunk->begin, chunk->end);
+	return true;
+    }
+
+    lines.end = newline + 1;
+
+    if (!range_is_empty (stream->pending.region))
+    {
+	// Complete the carried line, parse it, and continue from the chunk itself
+	const char * first = memchr (chunk->begin, '\n', chunk->end - chunk->begin);
+
+	_append (&stream->pending, chunk->begin, first + 1);
+
+	if (!_parse_lines (stream, &stream->pending.region.alias_const))
+	{
+	    return false;
+	}
+
+	window_rewrite (stream->pending);
+	lines.begin = first + 1;
+    }
+
+    if (!_parse_lines (stream, &lines))
+    {
+	return false;
+    }
+
+    _append (&stream->pending, newline + 1, chunk->end);
+
+    return true;
+}
+
+bool json_stream_finish (json_stream * stream)
+{
+    bool success;
+
+    if (range_is_empty (stream->pending.region))
+    {
+	return true;
+    }
+
+    *window_push (stream->pending) = '\n';
+
+    success = _parse_lines (stream, &stream->pending.region.alias_const);
+
+    window_rewrite (stream->pending);
+
+    return success;
+}
+
+void json_stream_clear (json_stream * stream)
+{
+    free (stream->pending.alloc.begin);
+    stream->pending = (window_char){0};
+}
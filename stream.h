@@ -0,0 +1,35 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#include "parse.h"
+#include "../window/def.h"
+#endif
+
+/*
+  Chunked parsing of newline delimited JSON. Input arrives in chunks of
+  any size through json_stream_feed; every complete line is parsed as
+  one value and handed to the callback, and a line split across chunks
+  is carried over until its end arrives. Blank lines are skipped.
+  json_stream_finish parses a final line that has no newline.
+
+  The callback may keep the value by copying it out and zeroing it,
+  otherwise it is cleared after the call. Lazy number text points into
+  the chunk or the carried line and is only valid during the call.
+  Returning false from the callback stops the stream.
+*/
+
+typedef bool (*json_stream_callback) (void * arg, json_value * value);
+
+typedef struct json_stream json_stream;
+struct json_stream {
+    json_parser_context * context;
+    json_stream_callback callback;
+    void * arg;
+    window_char pending;
+    size_t count;
+};
+
+bool json_stream_feed (json_stream * stream, const range_const_char * chunk);
+bool json_stream_finish (json_stream * stream);
+void json_stream_clear (json_stream * stream);
@@ -0,0 +1,112 @@
+#include "../binary.c"
+#include "../parse.h"
+
+#include <assert.h>
+
+static void _bound_text (range_const_char * range, const char * text)
+{
+    range->begin = text;
+    range->end = text + strlen (text);
+}
+
+static void _test_roundtrip (const char * input, size_t expect_size)
+{
+    range_const_char text;
+    window_char first = {0};
+    window_char second = {0};
+
+    _bound_text (&text, input);
+
+    json_value * parsed = json_parse (&text);
+    assert (parsed);
+
+    assert (json_encode_binary (&first, parsed));
+    log_normal ("Encoded %s in %zd bytes", json_type_name (parsed->type), (size_t) range_count (first.region));
+    assert ((size_t) range_count (first.region) == expect_size);
+
+    json_value * decoded = json_decode_binary (&first.region.alias_const);
+    assert (decoded);
+    assert (decoded->type == parsed->type);
+
+    assert (json_encode_binary (&second, decoded));
+    assert (range_count (first.region) == range_count (second.region));
+    assert (0 == memcmp (first.region.begin, second.region.begin, range_count (first.region)));
+
+    json_value_free (parsed);
+    json_value_free (decoded);
+    free (first.alloc.begin);
+    free (second.alloc.begin);
+}
+
+static void _test_decode_object ()
+{
+    range_const_char text;
+    window_char binary = {0};
+
+    _bound_text (&text, "{ \"name\" : \"value\", \"count\" : -3, \"ratio\" : 0.25, \"list\" : [ true, false, null ] }");
+
+    json_value * parsed = json_parse (&text);
+    assert (parsed);
+    assert (json_encode_binary (&binary, parsed));
+
+    json_value * decoded = json_decode_binary (&binary.region.alias_const);
+    assert (decoded);
+    assert (decoded->type == JSON_OBJECT);
+
+    assert (0 == strcmp (json_get_string (.parent = decoded->object, .key = "name"), "value"));
+    assert (json_get_number (.parent = decoded->object, .key = "count") == -3);
+    assert (json_get_number (.parent = decoded->object, .key = "ratio") == 0.25);
+
+    json_array list = json_elements (json_get_array (.parent = decoded->object, .key = "list"));
+    assert (range_count (list) == 3);
+    assert (list.begin[0].type == JSON_TRUE);
+    assert (list.begin[1].type == JSON_FALSE);
+    assert (list.begin[2].type == JSON_NULL);
+
+    json_value_free (parsed);
+    json_value_free (decoded);
+    free (binary.alloc.begin);
+}
+
+static void _test_packed ()
+{
+    range_const_char text;
+    window_char binary = {0};
+    json_parser_context context = { .pack_numbers = true, .lazy_numbers = true };
+
+    _bound_text (&text, "[ 1, -9007199254740993, 4, 9223372036854775807, -9223372036854775808 ]");
+
+    json_value * parsed = json_parse_with (&context, &text);
+    assert (parsed);
+    assert (parsed->flags & JSON_FLAG_PACKED_INT64);
+    assert (json_encode_binary (&binary, parsed));
+
+    // Elements past 53 bits keep every bit as varints
+    assert (range_count (binary.region) == 2 + 1 + 8 + 1 + 10 + 10);
+
+    json_value * decoded = json_decode_binary (&binary.region.alias_const);
+    assert (decoded);
+    assert (decoded->flags & JSON_FLAG_PACKED_INT64);
+    assert (decoded->count == 5);
+    assert (decoded->integers[1] == -9007199254740993);
+    assert (decoded->integers[3] == INT64_MAX);
+    assert (decoded->integers[4] == INT64_MIN);
+
+    json_value_free (parsed);
+    json_value_free (decoded);
+    json_parser_context_clear (&context);
+    free (binary.alloc.begin);
+}
+
+int main()
+{
+    _test_roundtrip ("null ", 1);
+    _test_roundtrip ("-12", 2);
+    _test_roundtrip ("1.5", 9);
+    _test_roundtrip ("\"abc\"", 5);
+    _test_roundtrip ("[ 1, 2, [ 3, \"x\" ] ]", 13);
+    _test_roundtrip ("{ \"a\" : { \"b\" : [ true ] } }", 11);
+    _test_roundtrip ("[ 1e400, -1e400 ]", 20);
+    _test_decode_object ();
+    _test_packed ();
+}
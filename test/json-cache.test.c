@@ -0,0 +1,86 @@
+#include "../cache.c"
+#include "../parse.h"
+
+static void _bound_text (range_const_char * range, const char * text)
+{
+    range->begin = text;
+    range->end = text + strlen (text);
+}
+
+static void _test_cache (const char * path)
+{
+    range_const_char text;
+    json_cache cache;
+
+    _bound_text (&text, "{ \"name\" : \"dataset\", \"size\" : 42, \"ok\" : true, \"none\" : null,"
+		 " \"points\" : [ 1, 2.5, \"three\", [ ] ], \"nested\" : { \"b\" : 2, \"a\" : 1, \"c\" : 3 } }");
+
+    json_value * parsed = json_parse (&text);
+    assert (parsed);
+    assert (json_cache_save (path, parsed));
+    json_value_free (parsed);
+
+    assert (json_cache_open (&cache, path));
+
+    const json_cache_node * root = json_cache_root (&cache);
+    assert (root->type == JSON_OBJECT);
+    assert (root->count == 6);
+
+    log_normal ("name: %s", json_cache_get_string (.parent = root, .key = "name"));
+    log_normal ("size: %f", json_cache_get_number (.parent = root, .key = "size"));
+    assert (json_cache_get_bool (.parent = root, .key = "ok"));
+    assert (json_cache_get_number (.parent = root, .key = "none", .optional = true, .default_value = 7) == 7);
+    assert (!json_cache_lookup (root, "missing"));
+
+    json_cache_array points = json_cache_get_array (.parent = root, .key = "points");
+    assert (range_count (points) == 4);
+    assert (points.begin[0].number == 1);
+    assert (points.begin[1].number == 2.5);
+    log_normal ("points[2]: %s", json_cache_string (points.begin + 2));
+    assert (range_count (json_cache_elements (points.begin + 3)) == 0);
+
+    const json_cache_node * nested = json_cache_get_object (.parent = root, .key = "nested");
+    assert (nested);
+
+    const char * keys[] = { "a", "b", "c" };
+
+    for (int i = 0; i < 3; i++)
+    {
+	log_normal ("nested.%s: %f", keys[i], json_cache_get_number (.parent = nested, .key = keys[i]));
+    }
+
+    json_cache_close (&cache);
+}
+
+static void _test_empty (const char * path)
+{
+    range_const_char text;
+    json_cache cache;
+
+    // An empty array parsed first, before the parser has any values of its own
+    _bound_text (&text, "[ ]");
+
+    json_value * parsed = json_parse (&text);
+    assert (parsed);
+    assert (parsed->type == JSON_ARRAY && parsed->count == 0);
+    assert (json_cache_save (path, parsed));
+    json_value_free (parsed);
+
+    assert (json_cache_open (&cache, path));
+    assert (json_cache_root (&cache)->type == JSON_ARRAY);
+    assert (range_count (json_cache_elements (json_cache_root (&cache))) == 0);
+    json_cache_close (&cache);
+}
+
+int main()
+{
+    char path[] = "/tmp/json-cache-test-XXXXXX";
+    int fd = mkstemp (path);
+    assert (fd >= 0);
+    close (fd);
+
+    _test_cache (path);
+    _test_empty (path);
+
+    unlink (path);
+}
@@ -0,0 +1,98 @@
+#include "../columns.c"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static void _load (json_columns * columns, const char * input)
+{
+    json_parser_context context = {0};
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    assert (json_to_columns (columns, &context, &text));
+
+    json_parser_context_clear (&context);
+}
+
+static void _print (const json_columns * columns)
+{
+    range_const_char string;
+    
+    for (size_t row = 0; row < columns->rows; row++)
+    {
+	for (size_t i = 0; i < columns->count; i++)
+	{
+	    const json_column * column = columns->columns + i;
+
+	    if (json_column_is_null (column, row))
+	    {
+		log_normal ("%zu %s: null", row, column->name);
+	    }
+	    else if (column->type == JSON_NUMBER)
+	    {
+		log_normal ("%zu %s: %g", row, column->name, json_column_number (column, row));
+	    }
+	    else
+	    {
+		string = json_column_string (column, row);
+		log_normal ("%zu %s: %.*s", row, column->name, (int) range_count (string), string.begin);
+	    }
+	}
+    }
+}
+
+static void _test_array ()
+{
+    json_column fields[] = {
+	{ .name = "id", .type = JSON_NUMBER },
+	{ .name = "name", .type = JSON_STRING },
+    };
+    
+    json_columns columns = { .columns = fields, .count = 2 };
+
+    _load (&columns, "[ { \"id\": 1, \"name\": \"one\", \"skip\": { \"a\": [1, 2, {}] } },"
+	   " { \"name\": \"t\\u00e9o\", \"id\": 2.5 },"
+	   " { \"id\": null, \"extra\": true },"
+	   " {} ] ");
+
+    assert (columns.rows == 4);
+    assert (json_column_number (fields, 1) == 2.5);
+    assert (json_column_is_null (fields, 2));
+    assert (json_column_is_null (fields + 1, 2));
+    assert (json_column_is_null (fields + 1, 3));
+    assert (!json_column_is_null (fields + 1, 1));
+    
+    _print (&columns);
+    
+    json_columns_clear (&columns);
+}
+
+static void _test_ndjson ()
+{
+    json_column fields[] = {
+	{ .name = "value", .type = JSON_NUMBER },
+    };
+    
+    json_columns columns = { .columns = fields, .count = 1 };
+
+    _load (&columns, "{\"value\": 1}\n{\"value\": 2}\n");
+    _load (&columns, "{\"other\": \"x\"}\n");
+
+    for (int i = 0; i < 10; i++)
+    {
+	_load (&columns, "{\"value\": -3e1}\n");
+    }
+
+    assert (columns.rows == 13);
+    assert (json_column_number (fields, 1) == 2);
+    assert (json_column_is_null (fields, 2));
+    assert (json_column_number (fields, 12) == -30);
+    assert (!json_column_is_null (fields, 12));
+
+    json_columns_clear (&columns);
+}
+
+int main ()
+{
+    _test_array ();
+    _test_ndjson ();
+}
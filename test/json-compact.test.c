@@ -0,0 +1,165 @@
+#include "../compact.c"
+#include "../parse.h"
+#include "../compare.h"
+#include "../shared.h"
+#include "../../log/log.h"
+
+static json_value * _parse (json_parser_context * context, const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse_with (context, &text);
+    assert (value);
+
+    return value;
+}
+
+// json_value_equal takes packed and unpacked arrays as equal, so the shape is checked by walking both trees
+static void _same_shape (const json_value * decoded, const json_value * value)
+{
+    json_field_iterator fields;
+    const json_value * element;
+    char key[64];
+
+    value = json_resolve (value);
+
+    assert (decoded->type == value->type);
+
+    if (value->type == JSON_OBJECT)
+    {
+	fields = json_field_iterator (value);
+
+	while (json_field_next (&fields))
+	{
+	    snprintf (key, sizeof(key), "%.*s", (int) range_count (fields.key), fields.key.begin);
+	    _same_shape (json_field (decoded, key), fields.value);
+	}
+    }
+    else if (value->type == JSON_ARRAY)
+    {
+	assert (!json_is_packed (decoded) == !json_is_packed (value));
+	assert (decoded->count == value->count);
+
+	if (!json_is_packed (value))
+	{
+	    for_range (element, json_elements (decoded))
+	    {
+		_same_shape (element, value->elements + (element - decoded->elements));
+	    }
+	}
+    }
+}
+
+static void _roundtrip (const json_value * value, const json_compact * compact)
+{
+    json_value decoded;
+
+    assert (json_compact_decode (&decoded, json_compact_root (compact)));
+    assert (json_value_equal (&decoded, value));
+    _same_shape (&decoded, value);
+
+    json_value_clear (&decoded);
+}
+
+static void _test_document ()
+{
+    json_parser_context context = {0};
+    json_compact compact;
+    json_compact_node root;
+    json_compact_node records;
+    json_compact_node record;
+    json_compact_node numbers;
+    range_const_char key;
+    bool success = true;
+
+    json_value * value = _parse (&context,
+	"{ \"records\" : ["
+	"    { \"host\" : \"alpha\", \"status\" : \"ok\", \"latency\" : 1.5, \"up\" : true },"
+	"    { \"host\" : \"beta\", \"status\" : \"ok\", \"latency\" : -20, \"up\" : false },"
+	"    { \"host\" : \"alpha\", \"status\" : \"down\", \"latency\" : null, \"up\" : false } ],"
+	"  \"ids\" : [ 1000000, 1000255, 999990 ],"
+	"  \"big\" : [ -9007199254740992, 9007199254740992 ],"
+	"  \"halves\" : [ 0.5, -1.25, 3 ],"
+	"  \"ratios\" : [ 0.1, 0.2 ],"
+	"  \"empty\" : { },"
+	"  \"none\" : [ ],"
+	"  \"mixed\" : [ 1, \"alpha\", [ 2, 3 ], { \"~\" : \"\" } ] }");
+
+    assert (json_compact_build (&compact, value));
+    root = json_compact_root (&compact);
+
+    assert (json_compact_type (root) == JSON_OBJECT);
+    assert (json_compact_count (root) == 8);
+
+    for (size_t i = 0; i < json_compact_count (root); i++)
+    {
+	key = json_compact_key (root, i);
+	log_normal ("key %zu: %.*s", i, (int) range_count (key), key.begin);
+    }
+
+    records = json_compact_get_array (root, "records", .success = &success);
+    assert (json_compact_count (records) == 3);
+
+    for (size_t i = 0; i < json_compact_count (records); i++)
+    {
+	record = json_compact_element (records, i);
+	log_normal ("%s %s %g %d",
+		    json_compact_get_string (record, "host", .success = &success),
+		    json_compact_get_string (record, "status", .success = &success),
+		    json_compact_get_number (record, "latency", .optional = true, .default_value = -1, .success = &success),
+		    json_compact_get_bool (record, "up", .success = &success));
+    }
+
+    assert (json_compact_string (json_compact_lookup (json_compact_element (records, 0), "host"))
+	    == json_compact_string (json_compact_lookup (json_compact_element (records, 2), "host")));
+
+    numbers = json_compact_lookup (root, "ids");
+    assert (json_compact_type (json_compact_element (numbers, 2)) == JSON_NUMBER);
+    assert (json_compact_number (json_compact_element (numbers, 2)) == 999990);
+    assert (json_compact_number (json_compact_element (json_compact_lookup (root, "halves"), 1)) == -1.25);
+    assert (json_compact_number (json_compact_element (json_compact_lookup (root, "ratios"), 0)) == 0.1);
+    assert (json_compact_type (json_compact_lookup (root, "missing")) == JSON_BADTYPE);
+    assert (json_compact_count (json_compact_get_object (root, "empty", .success = &success)) == 0);
+    assert (success);
+
+    log_normal ("compact size %zu, pool %zu", compact.size, compact.size - compact.pool);
+
+    _roundtrip (value, &compact);
+    json_compact_clear (&compact);
+
+    json_freeze (value);
+    assert (json_compact_build (&compact, value));
+    _roundtrip (value, &compact);
+    json_compact_clear (&compact);
+
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+static void _test_packed ()
+{
+    json_parser_context context = { .pack_numbers = true };
+    json_compact compact;
+    json_compact_node root;
+    json_value * value = _parse (&context, "[ [ 9223372036854775807, -9223372036854775808 ], [ 1e300, 2 ] ]");
+
+    assert (json_compact_build (&compact, value));
+    root = json_compact_root (&compact);
+
+    assert (json_compact_count (json_compact_element (root, 0)) == 2);
+    assert (json_compact_number (json_compact_element (json_compact_element (root, 1), 0)) == 1e300);
+
+    _roundtrip (value, &compact);
+
+    log_normal ("packed size %zu", compact.size);
+
+    json_compact_clear (&compact);
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+int main()
+{
+    _test_document ();
+    _test_packed ();
+}
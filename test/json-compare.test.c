@@ -0,0 +1,56 @@
+#include "../compare.c"
+#include "../parse.h"
+#include "../shared.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static json_value * _parse (const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse (&text);
+    assert (value);
+
+    return value;
+}
+
+static void _test_pair (bool expect, const char * a_text, const char * b_text)
+{
+    json_value * a = _parse (a_text);
+    json_value * b = _parse (b_text);
+
+    assert (json_value_equal (a, b) == expect);
+    assert (json_value_equal (b, a) == expect);
+
+    if (expect)
+    {
+	assert (json_value_hash (a) == json_value_hash (b));
+    }
+
+    json_freeze (a);
+    json_freeze (b);
+
+    assert (json_value_equal (a, b) == expect);
+
+    if (expect)
+    {
+	assert (json_value_hash (a) == json_value_hash (b));
+    }
+
+    log_normal ("%s %s %s", a_text, expect ? "==" : "!=", b_text);
+
+    json_value_free (a);
+    json_value_free (b);
+}
+
+int main()
+{
+    _test_pair (true, "{ \"a\" : 1, \"b\" : [ 1, 2 ] }", "{ \"b\" : [ 1.0, 2e0 ], \"a\" : 1 }");
+    _test_pair (true, "-0.0", "0");
+    _test_pair (true, "[ \"x\", { }, [ ] ]", "[ \"x\", { }, [ ] ]");
+    _test_pair (false, "[ 1, 2 ]", "[ 2, 1 ]");
+    _test_pair (false, "{ \"a\" : 1 }", "{ \"a\" : 1, \"b\" : 2 }");
+    _test_pair (false, "{ \"a\" : \"1\" }", "{ \"a\" : 1 }");
+    _test_pair (false, "{ \"a\" : { \"b\" : true } }", "{ \"a\" : { \"b\" : false } }");
+}
@@ -0,0 +1,91 @@
+#include "../compressed.c"
+#include "../traverse.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+#define LINES 20000
+
+static bool _count (void * arg, json_value * value)
+{
+    size_t * count = arg;
+    bool success = true;
+
+    assert ((size_t) json_get_number (value->object, "line", .success = &success) == *count);
+    assert (success);
+    
+    (*count)++;
+
+    return true;
+}
+
+static void _test_gzip_stream (const char * path)
+{
+    gzFile file = gzopen (path, "wb");
+    assert (file);
+
+    for (int i = 0; i < LINES; i++)
+    {
+	gzprintf (file, "{\"line\": %d, \"text\": \"padding to spread the lines over several buffers\"}\n", i);
+    }
+
+    assert (Z_OK == gzclose (file));
+
+    json_parser_context context = {0};
+    size_t count = 0;
+    json_stream stream = { .context = &context, .callback = _count, .arg = &count };
+
+    assert (json_stream_compressed_file (&stream, path));
+    assert (count == LINES);
+    log_normal ("Read %zu lines from a gzip stream", count);
+
+    json_stream_clear (&stream);
+    json_parser_context_clear (&context);
+}
+
+static void _test_document (const char * path, bool compress)
+{
+    const char * text = "{ \"a\": [1, 2, 3], \"b\": true }";
+
+    if (compress)
+    {
+	gzFile file = gzopen (path, "wb");
+	assert (file);
+	gzputs (file, text);
+	assert (Z_OK == gzclose (file));
+    }
+    else
+    {
+	FILE * file = fopen (path, "w");
+	assert (file);
+	fputs (text, file);
+	fclose (file);
+    }
+
+    json_parser_context context = { .lazy_numbers = true };
+    json_value * value = json_parse_compressed_file (&context, path);
+    assert (value);
+    assert (value->type == JSON_OBJECT);
+    assert (json_get_array (value->object, "a")->count == 3);
+    assert (json_number (json_get_array (value->object, "a")->elements + 2) == 3);
+    assert (context.lazy_numbers);
+
+    log_normal ("Read a %s document", compress ? "gzip" : "plain");
+    
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+int main ()
+{
+    char path[] = "/tmp/json-compressed-test-XXXXXX";
+    int fd = mkstemp (path);
+    assert (fd >= 0);
+    close (fd);
+
+    _test_gzip_stream (path);
+    _test_document (path, true);
+    _test_document (path, false);
+
+    unlink (path);
+}
@@ -0,0 +1,106 @@
+#include "../config.c"
+#include "../traverse.h"
+
+#include <assert.h>
+#include <time.h>
+
+static void _write_file (const char * path, const char * text)
+{
+    char temporary[256];
+
+    snprintf (temporary, sizeof(temporary), "%s.tmp", path);
+
+    FILE * file = fopen (temporary, "w");
+    assert (file);
+    fputs (text, file);
+    assert (0 == fclose (file));
+
+    assert (0 == rename (temporary, path));
+}
+
+static double _read_port (json_config_reader * reader)
+{
+    const json_value * root = json_config_read_begin (reader);
+    assert (root->type == JSON_OBJECT);
+
+    double port = json_get_number (.parent = root->object, .key = "port");
+
+    json_config_read_end (reader);
+
+    return port;
+}
+
+static bool _wait_for_port (json_config_reader * reader, double port)
+{
+    struct timespec delay = { .tv_nsec = 10 * 1000 * 1000 };
+
+    for (int i = 0; i < 500; i++)
+    {
+	if (_read_port (reader) == port)
+	{
+	    return true;
+	}
+
+	nanosleep (&delay, NULL);
+    }
+
+    return false;
+}
+
+int main()
+{
+    char directory[] = "/tmp/json-config-test-XXXXXX";
+    char path[256];
+
+    assert (mkdtemp (directory));
+    snprintf (path, sizeof(path), "%s/config.json", directory);
+
+    _write_file (path, "{ \"port\" : 80 }");
+
+    json_config * config = json_config_watch (path);
+    assert (config);
+
+    json_config_reader * reader = json_config_reader_new (config);
+    assert (reader);
+
+    log_normal ("Initial port %f", _read_port (reader));
+
+    const json_value * held = json_config_read_begin (reader);
+
+    _write_file (path, "{ \"port\" : 8080 }");
+
+    struct timespec delay = { .tv_nsec = 200 * 1000 * 1000 };
+    nanosleep (&delay, NULL);
+
+    assert (json_get_number (.parent = held->object, .key = "port") == 80);
+    json_config_read_end (reader);
+
+    assert (_wait_for_port (reader, 8080));
+    log_normal ("Reloaded port %f", _read_port (reader));
+
+    _write_file (path, "{ \"port\" : 9090 }");
+    assert (_wait_for_port (reader, 9090));
+    log_normal ("Reloaded port %f", _read_port (reader));
+
+    // Broken and empty documents leave the current snapshot in place
+    _write_file (path, "{ \"port\" : ");
+    nanosleep (&delay, NULL);
+    assert (_read_port (reader) == 9090);
+
+    FILE * file = fopen (path, "w");
+    assert (file);
+    assert (0 == fclose (file));
+    nanosleep (&delay, NULL);
+    assert (_read_port (reader) == 9090);
+    log_normal ("Kept port %f", _read_port (reader));
+
+    _write_file (path, "{ \"port\" : 7070 }");
+    assert (_wait_for_port (reader, 7070));
+    log_normal ("Reloaded port %f", _read_port (reader));
+
+    json_config_reader_free (reader);
+    json_config_free (config);
+
+    unlink (path);
+    rmdir (directory);
+}
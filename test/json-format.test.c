@@ -0,0 +1,69 @@
+#include "../format.c"
+#include "../../log/log.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+static void _test_minify (const char * input, const char * expect)
+{
+    window_char output = {0};
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    assert (json_minify (&output, &text));
+    assert (range_count (output.region) == (long) strlen (expect));
+    assert (0 == memcmp (output.region.begin, expect, strlen (expect)));
+
+    char * copy = strdup (input);
+    range_char in_place = { .begin = copy, .end = copy + strlen (copy) };
+
+    assert (json_minify_in_place (&in_place));
+    assert (range_count (in_place) == (long) strlen (expect));
+    assert (0 == memcmp (in_place.begin, expect, strlen (expect)));
+
+    free (copy);
+    free (output.alloc.begin);
+}
+
+static void _test_invalid_number (const char * input)
+{
+    window_char output = {0};
+    size_t size = strlen (input);
+    char * copy = malloc (size);
+
+    // The input is not terminated, so reading past it shows up under a sanitizer
+    memcpy (copy, input, size);
+    range_const_char text = { .begin = copy, .end = copy + size };
+
+    assert (!json_minify (&output, &text));
+
+    free (copy);
+    free (output.alloc.begin);
+}
+
+static void _test_reformat (const char * input, int indent)
+{
+    window_char output = {0};
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    assert (json_reformat (&output, &text, indent));
+    log_normal ("%.*s", (int) range_count (output.region), output.region.begin);
+
+    free (output.alloc.begin);
+}
+
+int main ()
+{
+    _test_minify (" { \"a\" : [ 1 , 2.5e3 , -0 ] ,\n\t\"b\" : { } , \"c\" : [ ] } \n", "{\"a\":[1,2.5e3,-0],\"b\":{},\"c\":[]}");
+    _test_minify ("  \"a string with  spaces, \\\"quotes\\\" and \\u00e9 escapes that is longer than thirty two bytes\"  ",
+		  "\"a string with  spaces, \\\"quotes\\\" and \\u00e9 escapes that is longer than thirty two bytes\"");
+    _test_minify ("[true,false,null]", "[true,false,null]");
+    _test_minify ("[\n                                                    1\n                                                    ]", "[1]");
+
+    _test_invalid_number ("[01]");
+    _test_invalid_number ("[-00]");
+    _test_invalid_number ("[1e");
+    _test_minify ("[0,-0.5,10]", "[0,-0.5,10]");
+    _test_reformat ("{\"a\":[1,{\"b\":null}],\"c\":{},\"d\":\"x\"}", 2);
+    _test_reformat ("[ [ ], 1 ]", 4);
+    _test_reformat ("{ \"a\" : 1 }", 0);
+}
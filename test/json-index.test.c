@@ -0,0 +1,108 @@
+#include "../index.c"
+#include "../traverse.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static void _write_file (const char * path, const char * text)
+{
+    FILE * file = fopen (path, "w");
+    assert (file);
+    fputs (text, file);
+    fclose (file);
+}
+
+static void _test_array (const char * source, const char * index_path)
+{
+    json_parser_context context = { .lazy_numbers = true };
+    json_index index;
+    json_value * value;
+    size_t position;
+    size_t child;
+
+    _write_file (source, "[ {\"id\": 0, \"name\": \"zero\"}, 1.5, [\"a\", \"b\", \"c\"], {\"id\": 3, \"tags\": {\"x\": true}} ]\n");
+
+    assert (json_index_build (source, index_path, 2));
+    assert (json_index_open (&index, source, index_path));
+
+    assert (json_index_count (&index, JSON_INDEX_ROOT) == 4);
+
+    assert (json_index_child (&position, &index, JSON_INDEX_ROOT, 1));
+    value = json_parse_at (&context, &index, position);
+    assert (value && json_number (value) == 1.5);
+    json_value_free (value);
+
+    assert (json_index_child (&position, &index, JSON_INDEX_ROOT, 2));
+    assert (json_index_count (&index, position) == 3);
+    assert (json_index_child (&child, &index, position, 2));
+    assert (!json_index_lookup (&child, &index, position, "a"));
+    value = json_parse_at (&context, &index, child);
+    assert (value && value->type == JSON_STRING);
+    log_normal ("element 2 of element 2: %s", value->string);
+    json_value_free (value);
+
+    assert (json_index_child (&position, &index, JSON_INDEX_ROOT, 3));
+    assert (json_index_lookup (&child, &index, position, "tags"));
+    assert (0 == strcmp (json_index_key (&index, child), "tags"));
+    assert (!json_index_lookup (&child, &index, position, "missing"));
+    assert (json_index_lookup (&child, &index, position, "id"));
+    value = json_parse_at (&context, &index, child);
+    assert (value && json_number (value) == 3);
+    json_value_free (value);
+
+    json_index_close (&index);
+    json_parser_context_clear (&context);
+}
+
+static void _test_object (const char * source, const char * index_path)
+{
+    json_parser_context context = {0};
+    json_index index;
+    json_value * value;
+    size_t position;
+
+    _write_file (source, "{ \"m\": {\"v\": 1}, \"b\\u00e9\": [2], \"a\": null, \"z\": \"last\" }");
+
+    assert (json_index_build (source, index_path, 1));
+    assert (json_index_open (&index, source, index_path));
+
+    assert (json_index_count (&index, JSON_INDEX_ROOT) == 4);
+
+    for (size_t i = 0; i < 4; i++)
+    {
+	assert (json_index_child (&position, &index, JSON_INDEX_ROOT, i));
+	assert (json_index_count (&index, position) == 0);
+	log_normal ("key %zu: %s", i, json_index_key (&index, position));
+    }
+
+    assert (json_index_lookup (&position, &index, JSON_INDEX_ROOT, "b\xc3\xa9"));
+    value = json_parse_at (&context, &index, position);
+    assert (value && value->type == JSON_ARRAY && value->count == 1);
+    json_value_free (value);
+
+    assert (json_index_lookup (&position, &index, JSON_INDEX_ROOT, "m"));
+    value = json_parse_at (&context, &index, position);
+    assert (value && value->type == JSON_OBJECT);
+    assert (json_get_number (value->object, "v") == 1);
+    json_value_free (value);
+
+    json_index_close (&index);
+    json_parser_context_clear (&context);
+}
+
+int main ()
+{
+    char source[] = "/tmp/json-index-test-XXXXXX";
+    int fd = mkstemp (source);
+    assert (fd >= 0);
+    close (fd);
+
+    char index_path[sizeof(source) + 4];
+    snprintf (index_path, sizeof(index_path), "%s.idx", source);
+
+    _test_array (source, index_path);
+    _test_object (source, index_path);
+
+    unlink (source);
+    unlink (index_path);
+}
@@ -0,0 +1,289 @@
+#include "../query.c"
+#include "../writer.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static bool _collect (void * arg, const char * bytes, size_t size)
+{
+    window_char * output = arg;
+
+    while (size--)
+    {
+	*window_push (*output) = *bytes++;
+    }
+
+    return true;
+}
+
+static void _print_groups (const json_value * groups)
+{
+    window_char output = {0};
+    json_writer writer;
+
+    for (size_t i = 0; i < groups->count; i++)
+    {
+	window_rewrite (output);
+	json_writer_init_sink (&writer, _collect, &output, true);
+	assert (json_writer_value (&writer, groups->elements + i));
+	assert (json_writer_flush (&writer));
+	*window_push (output) = '\0';
+	log_normal ("%s", output.region.begin);
+    }
+
+    free (output.alloc.begin);
+}
+
+static void _run (json_query_result * result, const json_query * query, const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    assert (json_query_run (result, query, &text));
+}
+
+static void _print_rows (const json_query_result * result)
+{
+    log_normal ("%zu records, %zu matched", result->records, result->matched);
+    log_normal ("%.*s", (int) range_count (result->rows.region), result->rows.region.begin);
+}
+
+static const char * _records =
+    "{\"id\": 1, \"user\": {\"name\": \"ann\", \"age\": 31}, \"status\": 200, \"bytes\": 512}\n"
+    "{\"id\": 2, \"user\": {\"name\": \"bob\"}, \"status\": 404, \"bytes\": 0}\n"
+    "\n"
+    "{\"id\": 3, \"user\": {\"name\": \"c\\u00e9\", \"age\": 27}, \"status\": 200, \"bytes\": 2048, \"tags\": [1, {\"a\": \"}\"}]}\n"
+    "{\"id\": 4, \"status\": 500, \"bytes\": \"n/a\"}\n"
+    "{\"id\": 5, \"user\": {\"name\": \"ann\", \"age\": 31}, \"status\": 200.0, \"bytes\": 128}\n";
+
+static void _test_filter ()
+{
+    const char * select[] = { "id", "user.name", "tags" };
+    json_query_predicate where[] = {
+	{ .path = "status", .op = JSON_QUERY_EQ, .value = { .type = JSON_NUMBER, .number = 200 } },
+	{ .path = "user.age", .op = JSON_QUERY_GE, .value = { .type = JSON_NUMBER, .number = 30 } },
+    };
+    json_query query = { .where = where, .where_count = 2, .select = select, .select_count = 3 };
+    json_query_result result;
+
+    _run (&result, &query, _records);
+    assert (result.records == 5);
+    assert (result.matched == 2);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+
+    // A missing member compares as null
+    where[0] = (json_query_predicate){ .path = "user.age", .op = JSON_QUERY_NE, .value = { .type = JSON_NULL } };
+    query.where_count = 1;
+    _run (&result, &query, _records);
+    assert (result.matched == 3);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+
+    where[0] = (json_query_predicate){ .path = "user.name", .op = JSON_QUERY_LT, .value = { .type = JSON_STRING, .string = "b", .count = 1 } };
+    _run (&result, &query, _records);
+    assert (result.matched == 2);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+
+    where[0] = (json_query_predicate){ .path = "tags", .op = JSON_QUERY_EXISTS };
+    query.select_count = 0;
+    _run (&result, &query, _records);
+    assert (result.matched == 1);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+
+    // Arrays and objects have no order or canonical spelling to compare
+    where[0] = (json_query_predicate){ .path = "tags", .op = JSON_QUERY_EQ, .value = { .type = JSON_ARRAY } };
+    assert (!json_query_run (&result, &query, &(range_const_char){ .begin = _records, .end = _records + strlen (_records) }));
+    json_query_result_clear (&result);
+}
+
+static void _test_array ()
+{
+    const char * select[] = { "b" };
+    json_query_predicate where[] = {
+	{ .path = "a", .op = JSON_QUERY_GT, .value = { .type = JSON_NUMBER, .number = 1 } },
+    };
+    json_query query = { .where = where, .where_count = 1, .select = select, .select_count = 1 };
+    json_query_result result;
+
+    _run (&result, &query, " [ {\"a\": 1, \"b\": \"x,]\"}, {\"a\": 2, \"b\": [1, 2]},\n {\"a\": 3} ] \n");
+    assert (result.records == 3);
+    assert (result.matched == 2);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+
+    _run (&result, &query, "[]");
+    assert (result.records == 0);
+    json_query_result_clear (&result);
+
+    // A stream of arrays is not one top level array
+    query.where_count = 0;
+    query.select_count = 0;
+    _run (&result, &query, "[1, 2]\n[3, {\"a\": \"]\"}]\n\"x\"");
+    assert (result.records == 3);
+    _print_rows (&result);
+    json_query_result_clear (&result);
+}
+
+static void _test_groups ()
+{
+    json_query_aggregate aggregates[] = {
+	{ .name = "total", .function = JSON_QUERY_SUM, .path = "bytes" },
+	{ .name = "smallest", .function = JSON_QUERY_MIN, .path = "bytes" },
+	{ .name = "oldest", .function = JSON_QUERY_MAX, .path = "user.age" },
+    };
+    json_query query = { .group_by = "status", .aggregates = aggregates, .aggregate_count = 3 };
+    json_query_result result;
+
+    _run (&result, &query, _records);
+    assert (result.groups.type == JSON_ARRAY);
+    assert (result.groups.count == 3);
+    _print_groups (&result.groups);
+    json_query_result_clear (&result);
+
+    query.group_by = "user";
+    query.aggregate_count = 0;
+    _run (&result, &query, _records);
+    assert (result.groups.count == 4);
+    _print_groups (&result.groups);
+    json_query_result_clear (&result);
+
+    // A key keeps the bytes after an escaped NUL
+    _run (&result, &query, "{\"user\": \"a\\u0000b\"} {\"user\": \"a\"}");
+    assert (result.groups.count == 2);
+    _print_groups (&result.groups);
+    json_query_result_clear (&result);
+
+    query.group_by = NULL;
+    query.aggregate_count = 1;
+    _run (&result, &query, _records);
+    assert (result.groups.count == 1);
+    _print_groups (&result.groups);
+    json_query_result_clear (&result);
+}
+
+static void _test_parallel ()
+{
+    const char * select[] = { "i" };
+    json_query_predicate where[] = {
+	{ .path = "odd", .op = JSON_QUERY_EQ, .value = { .type = JSON_TRUE } },
+    };
+    json_query_aggregate aggregates[] = {
+	{ .name = "sum", .function = JSON_QUERY_SUM, .path = "i" },
+	{ .name = "max", .function = JSON_QUERY_MAX, .path = "i" },
+    };
+    json_query query = { .where = where, .where_count = 1, .select = select, .select_count = 1, .threads = 4 };
+    json_query_result result;
+    window_char lines = {0};
+    window_char array = {0};
+    window_char pretty = {0};
+    window_char expect = {0};
+    char line[128];
+    size_t count = 200000;
+    size_t sum = 0;
+    int size;
+
+    *window_push (array) = '[';
+
+    for (size_t i = 0; i < count; i++)
+    {
+	size = snprintf (line, sizeof(line), "{\"i\": %zu, \"odd\": %s, \"m\": %zu, \"pad\": \"a,b]{\"}\n", i, i % 2 ? "true" : "false", i % 3);
+	_push_bytes (&lines, line, size);
+	_push_bytes (&array, line, size);
+	*window_push (array) = i + 1 < count ? ',' : ']';
+
+	// Records spread over lines, with some not separated at all
+	size = snprintf (line, sizeof(line), "{\n  \"i\": %zu,\n  \"odd\": %s,\n  \"m\": %zu,\n  \"pad\": \"a,b]{\"\n}%s", i, i % 2 ? "true" : "false", i % 3, i % 2 ? "" : "\n");
+	_push_bytes (&pretty, line, size);
+
+	if (i % 2)
+	{
+	    size = snprintf (line, sizeof(line), "{\"i\":%zu}\n", i);
+	    _push_bytes (&expect, line, size);
+	    sum += i;
+	}
+    }
+
+    assert (range_count (lines.region) > 4 * JSON_QUERY_CHUNK_SIZE);
+
+    assert (json_query_run (&result, &query, &lines.region.alias_const));
+    assert (result.records == count);
+    assert (result.matched == count / 2);
+    assert (range_count (result.rows.region) == range_count (expect.region));
+    assert (0 == memcmp (result.rows.region.begin, expect.region.begin, range_count (expect.region)));
+    json_query_result_clear (&result);
+
+    assert (json_query_run (&result, &query, &array.region.alias_const));
+    assert (result.records == count);
+    assert (range_count (result.rows.region) == range_count (expect.region));
+    assert (0 == memcmp (result.rows.region.begin, expect.region.begin, range_count (expect.region)));
+    json_query_result_clear (&result);
+
+    assert (range_count (pretty.region) > 4 * JSON_QUERY_CHUNK_SIZE);
+    assert (json_query_run (&result, &query, &pretty.region.alias_const));
+    assert (result.records == count);
+    assert (range_count (result.rows.region) == range_count (expect.region));
+    assert (0 == memcmp (result.rows.region.begin, expect.region.begin, range_count (expect.region)));
+    json_query_result_clear (&result);
+
+    query.group_by = "m";
+    query.aggregates = aggregates;
+    query.aggregate_count = 2;
+    assert (json_query_run (&result, &query, &array.region.alias_const));
+    assert (result.groups.count == 3);
+    _print_groups (&result.groups);
+    json_query_result_clear (&result);
+
+    log_normal ("parallel sum %zu", sum);
+
+    free (lines.alloc.begin);
+    free (array.alloc.begin);
+    free (pretty.alloc.begin);
+    free (expect.alloc.begin);
+}
+
+static void _test_long_string ()
+{
+    const char * select[] = { "i" };
+    json_query query = { .select = select, .select_count = 1, .threads = 3 };
+    json_query_result result;
+    window_char input = {0};
+    const char * pad = "\\\"]}\\\\, {[\\n";
+    const char * head;
+    const char * tail;
+
+    // Segment marks land inside the string, where brackets and escaped quotes must not count
+    for (int array = 0; array < 2; array++)
+    {
+	window_rewrite (input);
+	head = array ? "[{\"i\": 0, \"s\": \"" : "{\"i\": 0, \"s\": \"";
+	tail = array ? "\"}, {\"i\": 1}]" : "\"}\n{\"i\": 1}";
+	_push_bytes (&input, head, strlen (head));
+
+	while (range_count (input.region) < 3 * JSON_QUERY_CHUNK_SIZE)
+	{
+	    _push_bytes (&input, pad, strlen (pad));
+	}
+
+	_push_bytes (&input, tail, strlen (tail));
+
+	assert (json_query_run (&result, &query, &input.region.alias_const));
+	assert (result.records == 2);
+	_print_rows (&result);
+	json_query_result_clear (&result);
+    }
+
+    free (input.alloc.begin);
+}
+
+int main ()
+{
+    _test_filter ();
+    _test_array ();
+    _test_groups ();
+    _test_parallel ();
+    _test_long_string ();
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "../reclaim.c"
+#include "../parse.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define THREADS 4
+#define DOCUMENTS 200
+
+static json_value * _parse (const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse (&text);
+    assert (value);
+
+    return value;
+}
+
+static void * _defer_documents (void * arg)
+{
+    json_value * value;
+
+    for (int i = 0; i < DOCUMENTS; i++)
+    {
+	value = _parse ("{ \"a\": [1, 2, {\"b\": \"string\"}], \"c\": { \"d\": [ [], {} ] } }");
+	json_value_free_deferred (value);
+    }
+
+    return NULL;
+}
+
+static void _test_threads ()
+{
+    pthread_t threads[THREADS];
+
+    for (int i = 0; i < THREADS; i++)
+    {
+	assert (0 == pthread_create (threads + i, NULL, _defer_documents, NULL));
+    }
+
+    for (int i = 0; i < THREADS; i++)
+    {
+	pthread_join (threads[i], NULL);
+    }
+
+    json_reclaim_flush ();
+
+    assert (atomic_load (&_reclaimer.freed) == THREADS * DOCUMENTS);
+    log_normal ("Freed %d documents in the background", THREADS * DOCUMENTS);
+}
+
+static void _test_clear_and_restart ()
+{
+    json_value * box = _parse ("[\"x\", [\"y\"]] ");
+    json_value value = *box;
+    free (box);
+
+    json_value_clear_deferred (&value);
+    assert (value.type == JSON_NULL);
+
+    json_reclaim_stop ();
+    assert (!atomic_load (&_reclaimer.running));
+
+    json_value_free_deferred (_parse ("\"restarted\""));
+    assert (atomic_load (&_reclaimer.running));
+
+    json_reclaim_stop ();
+    assert (atomic_load (&_reclaimer.freed) == THREADS * DOCUMENTS + 2);
+}
+
+int main ()
+{
+    _test_threads ();
+    _test_clear_and_restart ();
+}
@@ -0,0 +1,132 @@
+#include "../schema.c"
+#include "../../log/log.h"
+
+static json_schema * _compile_text (const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+    json_value * document = json_parse (&text);
+    json_schema * schema;
+
+    assert (document);
+
+    schema = json_schema_compile (document);
+    assert (schema);
+
+    json_value_free (document);
+
+    return schema;
+}
+
+static void _test (json_validator * validator, const json_schema * schema, bool expect, const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+    bool valid = json_schema_validate (validator, schema, &text);
+
+    assert (valid == expect);
+
+    if (valid)
+    {
+	log_normal ("valid: %s", input);
+    }
+    else
+    {
+	log_normal ("invalid: %s: '%s' %s at byte %zu", input, validator->path.region.begin, validator->reason, validator->offset);
+    }
+}
+
+static void _test_records ()
+{
+    json_validator validator = {0};
+    json_schema * schema = _compile_text (
+	"{ \"type\" : \"object\","
+	"  \"required\" : [ \"id\", \"name\" ],"
+	"  \"properties\" : {"
+	"    \"id\" : { \"type\" : \"integer\", \"minimum\" : 1 },"
+	"    \"name\" : { \"type\" : \"string\", \"minLength\" : 1, \"maxLength\" : 4 },"
+	"    \"kind\" : { \"enum\" : [ \"a\", \"b\", null ] },"
+	"    \"score\" : { \"type\" : [ \"number\", \"null\" ], \"exclusiveMaximum\" : 10, \"multipleOf\" : 0.5 },"
+	"    \"tags\" : { \"type\" : \"array\", \"maxItems\" : 2, \"items\" : { \"type\" : \"string\" } },"
+	"    \"a/b\" : { \"type\" : \"object\", \"additionalProperties\" : false, \"properties\" : { \"x\" : true } }"
+	"  } }");
+
+    _test (&validator, schema, true, "{ \"id\" : 1, \"name\" : \"\xc3\xa9t\xc3\xa9!\", \"extra\" : [ { \"ignored\" : [ 1, 2 ] } ] }");
+    _test (&validator, schema, true, "{ \"name\" : \"x\", \"id\" : 2.0, \"kind\" : null, \"score\" : 9.5, \"tags\" : [ \"t\" ], \"a/b\" : { \"x\" : { } } }");
+    _test (&validator, schema, false, "{ \"id\" : 1.5, \"name\" : \"x\" }");
+    _test (&validator, schema, false, "{ \"id\" : 0, \"name\" : \"x\" }");
+    _test (&validator, schema, false, "{ \"id\" : 1 }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"\" }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"xxxxx\" }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"kind\" : \"c\" }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"score\" : 10 }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"score\" : 0.3 }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"tags\" : [ \"t\", 2 ] }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"tags\" : [ \"t\", \"u\", \"v\" ] }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"a/b\" : { \"y\" : 1 } }");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\", \"extra\" : [ 1, ] }");
+    _test (&validator, schema, false, "[ ]");
+    _test (&validator, schema, false, "{ \"id\" : 1, \"name\" : \"x\" } { }");
+
+    json_schema_free (schema);
+    json_validator_clear (&validator);
+}
+
+static void _test_constants ()
+{
+    json_validator validator = {0};
+    json_schema * schema = _compile_text ("{ \"const\" : 1, \"enum\" : [ 2 ] }");
+
+    _test (&validator, schema, false, "1");
+    _test (&validator, schema, false, "2");
+    json_schema_free (schema);
+
+    schema = _compile_text ("{ \"const\" : \"a\", \"enum\" : [ \"a\", \"b\" ] }");
+    _test (&validator, schema, true, "\"a\"");
+    _test (&validator, schema, false, "\"b\"");
+    _test (&validator, schema, false, "[ \"a\" ]");
+    json_schema_free (schema);
+
+    schema = _compile_text ("{ \"required\" : [ \"x\" ], \"additionalProperties\" : { \"type\" : \"number\" } }");
+    _test (&validator, schema, true, "{ \"x\" : 1 }");
+    _test (&validator, schema, false, "{ \"x\" : \"str\" }");
+    json_schema_free (schema);
+
+    schema = _compile_text ("{ \"required\" : [ \"x\" ], \"additionalProperties\" : false }");
+    _test (&validator, schema, false, "{ \"x\" : 1 }");
+    json_schema_free (schema);
+
+    const char * zero = "{ \"multipleOf\" : 0 }";
+    range_const_char text = { .begin = zero, .end = zero + strlen (zero) };
+    json_value * document = json_parse (&text);
+    assert (document);
+    assert (!json_schema_compile (document));
+    json_value_free (document);
+
+    json_validator_clear (&validator);
+}
+
+static void _test_stream ()
+{
+    json_validator validator = {0};
+    json_schema * schema = _compile_text ("{ \"properties\" : { \"n\" : { \"maximum\" : 2 } } }");
+    const char * input = "{ \"n\" : 1 }\n{ \"n\" : 2 }\n{ \"n\" : 3 }\n";
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+    size_t records = 0;
+
+    while (json_scan_next (&text) == JSON_OBJECT && json_schema_check (&validator, schema, &text))
+    {
+	records++;
+    }
+
+    assert (records == 2);
+    log_normal ("record %zu: '%s' %s", records, validator.path.region.begin, validator.reason);
+
+    json_schema_free (schema);
+    json_validator_clear (&validator);
+}
+
+int main()
+{
+    _test_records ();
+    _test_constants ();
+    _test_stream ();
+}
@@ -0,0 +1,178 @@
+#include "../shape.c"
+#include "../parse.h"
+#include "../traverse.h"
+#include "../compare.h"
+#include "../shared.h"
+#include "../writer.h"
+#include "../../window/alloc.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static json_value * _parse (json_parser_context * context, const char * input)
+{
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse_with (context, &text);
+    assert (value);
+
+    return value;
+}
+
+static bool _collect (void * arg, const char * bytes, size_t size)
+{
+    window_char * output = arg;
+
+    while (size--)
+    {
+	*window_push (*output) = *bytes++;
+    }
+
+    return true;
+}
+
+static void _print (const json_value * value)
+{
+    window_char output = {0};
+    json_writer writer;
+
+    json_writer_init_sink (&writer, _collect, &output, true);
+    assert (json_writer_value (&writer, value));
+    assert (json_writer_flush (&writer));
+    *window_push (output) = '\0';
+
+    log_normal ("%s", output.region.begin);
+
+    free (output.alloc.begin);
+}
+
+static void _test_records ()
+{
+    json_parser_context context = { .share_shapes = true };
+    json_field_cache cache = {0};
+    json_value * records[3];
+    json_value * table;
+    json_value * copy;
+
+    records[0] = _parse (&context, "{ \"id\" : 1, \"name\" : \"a\", \"tags\" : { \"x\" : true } }");
+    records[1] = _parse (&context, "{ \"id\" : 2, \"name\" : \"b\", \"tags\" : { \"x\" : false } }");
+    records[2] = _parse (&context, "{ \"name\" : \"c\", \"id\" : 3, \"tags\" : { } }");
+
+    assert (records[0]->flags & JSON_FLAG_SHAPED);
+    assert (records[0]->shaped->shape == records[1]->shaped->shape);
+    assert (records[0]->shaped->shape != records[2]->shaped->shape);
+    assert (json_object_size (records[2]) == 3);
+
+    for (int i = 0; i < 3; i++)
+    {
+	assert (json_number (json_field_cached (records[i], "id", &cache)) == i + 1);
+	assert (json_field (records[i], "name")->count == 1);
+	assert (!json_field (records[i], "missing"));
+	_print (records[i]);
+    }
+
+    // Objects keep their shapes alive once the context is gone
+    json_parser_context_clear (&context);
+    context.share_shapes = false;
+
+    table = _parse (&context, "{ \"tags\" : { \"x\" : true }, \"name\" : \"a\", \"id\" : 1.0 }");
+    assert (!(table->flags & JSON_FLAG_SHAPED));
+    assert (json_value_equal (table, records[0]));
+    assert (json_value_hash (table) == json_value_hash (records[0]));
+    assert (!json_value_equal (records[0], records[1]));
+
+    copy = calloc (1, sizeof(*copy));
+    assert (json_clone (copy, records[1]));
+    json_freeze (copy);
+    assert (json_value_equal (copy, records[1]));
+    assert (json_number (json_field (copy, "id")) == 2);
+
+    for (int i = 0; i < 3; i++)
+    {
+	json_value_free (records[i]);
+    }
+
+    json_value_free (copy);
+    json_value_free (table);
+    json_parser_context_clear (&context);
+}
+
+static void _test_fallback ()
+{
+    json_parser_context context = { .share_shapes = true };
+    json_value * value = _parse (&context, "[ { \"a\" : 1, \"a\" : 2 }, { \"a\" : [ { \"b\" : null } ] }, { } ]");
+
+    assert (!(value->elements[0].flags & JSON_FLAG_SHAPED));
+    assert (json_number (json_field (value->elements + 0, "a")) == 2);
+    assert (value->elements[1].flags & JSON_FLAG_SHAPED);
+    assert (json_field (json_field (value->elements + 1, "a")->elements, "b")->type == JSON_NULL);
+    assert (json_object_size (value->elements + 2) == 0);
+
+    _print (value);
+
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+static void _test_limits ()
+{
+    json_parser_context context = { .share_shapes = true };
+    window_char text = {0};
+    char member[64];
+    size_t count = JSON_SHAPE_MAX_SHAPES + 100;
+    json_value * value;
+    int size;
+
+    // Every record brings a new key, so the table fills up and later records fall back to tables
+    *window_push (text) = '[';
+
+    for (size_t i = 0; i < count; i++)
+    {
+	size = snprintf (member, sizeof(member), "%s{ \"key%zu\" : { \"v\" : \"%zu\" } }", i ? "," : "", i, i);
+	_collect (&text, member, size);
+    }
+
+    *window_push (text) = ']';
+    *window_push (text) = '\0';
+
+    value = _parse (&context, text.region.begin);
+    assert (value->count == count);
+    assert (context.shapes->count == JSON_SHAPE_MAX_SHAPES);
+    assert (value->elements[0].flags & JSON_FLAG_SHAPED);
+    assert (!(value->elements[count - 1].flags & JSON_FLAG_SHAPED));
+    snprintf (member, sizeof(member), "key%zu", count - 1);
+    assert (0 == strcmp (json_field (json_field (value->elements + count - 1, member), "v")->string, "4195"));
+    json_value_free (value);
+
+    // Past the key limit the members read so far move into the table
+    window_rewrite (text);
+    *window_push (text) = '{';
+
+    for (int i = 0; i < JSON_SHAPE_MAX_KEYS + 6; i++)
+    {
+	size = snprintf (member, sizeof(member), "%s\"m%d\" : [ \"s%d\" ]", i ? "," : "", i, i);
+	_collect (&text, member, size);
+    }
+
+    *window_push (text) = '}';
+    *window_push (text) = '\0';
+
+    value = _parse (&context, text.region.begin);
+    assert (!(value->flags & JSON_FLAG_SHAPED));
+    assert (json_object_size (value) == JSON_SHAPE_MAX_KEYS + 6);
+    assert (0 == strcmp (json_field (value, "m0")->elements[0].string, "s0"));
+    assert (0 == strcmp (json_field (value, "m63")->elements[0].string, "s63"));
+    assert (0 == strcmp (json_field (value, "m69")->elements[0].string, "s69"));
+    json_value_free (value);
+
+    free (text.alloc.begin);
+    context.share_shapes = false;
+    json_parser_context_clear (&context);
+}
+
+int main()
+{
+    _test_records ();
+    _test_fallback ();
+    _test_limits ();
+}
@@ -0,0 +1,88 @@
+#include "../shared.c"
+#include "../parse.h"
+
+static void _bound_text (range_const_char * range, const char * text)
+{
+    range->begin = text;
+    range->end = text + strlen (text);
+}
+
+static const json_value * _child (const json_value * object, const char * key)
+{
+    object = json_resolve (object);
+    assert (object->type == JSON_OBJECT);
+
+    json_pair * pair = json_lookup_string (object->object, key);
+    assert (pair);
+
+    return &pair->value;
+}
+
+static void _test_copy_on_write ()
+{
+    range_const_char text;
+
+    _bound_text (&text, "{ \"server\" : { \"port\" : 80, \"host\" : \"example\" },"
+		 " \"limits\" : { \"depth\" : 8, \"names\" : [ \"a\", \"b\" ] } }");
+
+    json_value * base = json_parse (&text);
+    assert (base);
+
+    json_freeze (base);
+    assert (base->type == JSON_SHARED);
+
+    json_value request;
+    assert (json_clone (&request, base));
+    assert (request.shared == base->shared);
+
+    json_value * port = json_thaw_key (json_thaw_key (&request, "server"), "port");
+    assert (port);
+    assert (port->type == JSON_NUMBER);
+    port->number = 8080;
+
+    assert (request.type == JSON_OBJECT);
+    assert (base->type == JSON_SHARED);
+
+    assert (_child (_child (base, "server"), "port")->number == 80);
+    assert (_child (_child (&request, "server"), "port")->number == 8080);
+
+    assert (_child (&request, "limits")->type == JSON_SHARED);
+    assert (_child (&request, "limits")->shared == _child (base, "limits")->shared);
+    assert (_child (_child (&request, "server"), "host")->shared == _child (_child (base, "server"), "host")->shared);
+
+    log_normal ("base port %f, request port %f, limits shared by %zd documents",
+		json_get_number (.parent = json_resolve (_child (base, "server"))->object, .key = "port"),
+		json_get_number (.parent = _child (&request, "server")->object, .key = "port"),
+		(size_t) atomic_load (&_child (base, "limits")->shared->references));
+
+    json_value_clear (&request);
+    json_value_free (base);
+}
+
+static void _test_sole_owner ()
+{
+    range_const_char text;
+
+    _bound_text (&text, "[ 1, [ 2, 3 ], \"x\" ]");
+
+    json_value * value = json_parse (&text);
+    assert (value);
+
+    json_freeze (value);
+
+    json_value * element = json_thaw_index (value, 1);
+    assert (element);
+    assert (value->type == JSON_ARRAY);
+    assert (element->type == JSON_ARRAY);
+    assert (element->elements[1].number == 3);
+
+    assert (!json_thaw_index (value, 3));
+
+    json_value_free (value);
+}
+
+int main()
+{
+    _test_copy_on_write ();
+    _test_sole_owner ();
+}
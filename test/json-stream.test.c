@@ -0,0 +1,66 @@
+#include "../stream.c"
+#include "../traverse.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+typedef struct {
+    int count;
+    double sum;
+    json_value kept;
+}
+    totals;
+
+static bool _add (void * arg, json_value * value)
+{
+    totals * total = arg;
+    bool success = true;
+
+    assert (value->type == JSON_OBJECT);
+
+    total->sum += json_get_number (value->object, "n", .success = &success);
+    assert (success);
+    
+    if (total->count++ == 1)
+    {
+	total->kept = *value;
+	*value = (json_value){0};
+    }
+
+    return true;
+}
+
+static void _test_chunks (size_t chunk_size)
+{
+    const char * input = "{\"n\": 1}\n\n{\"n\": 2, \"s\": \"a\\nb\"}\r\n  {\"n\": 3.5}\n{\"n\": -4, \"t\": null}";
+    const char * end = input + strlen (input);
+    json_parser_context context = { .lazy_numbers = true };
+    totals total = {0};
+    json_stream stream = { .context = &context, .callback = _add, .arg = &total };
+    range_const_char chunk;
+
+    for (chunk.begin = input; chunk.begin < end; chunk.begin = chunk.end)
+    {
+	chunk.end = chunk.begin + chunk_size < end ? chunk.begin + chunk_size : end;
+	assert (json_stream_feed (&stream, &chunk));
+    }
+
+    assert (json_stream_finish (&stream));
+
+    assert (total.count == 4);
+    assert (total.sum == 2.5);
+    assert (0 == strcmp (json_get_string (total.kept.object, "s"), "a\nb"));
+
+    log_normal ("chunks of %zu: %d values, sum %g", chunk_size, total.count, total.sum);
+    
+    json_value_clear (&total.kept);
+    json_stream_clear (&stream);
+    json_parser_context_clear (&context);
+}
+
+int main ()
+{
+    _test_chunks (1);
+    _test_chunks (7);
+    _test_chunks (1000);
+}
@@ -0,0 +1,77 @@
+#include "../utf8.c"
+#include "../parse.h"
+#include "../../log/log.h"
+
+#include <assert.h>
+
+static void _test_valid (bool expect, const char * text, size_t size)
+{
+    range_const_char range = { .begin = text, .end = text + size };
+
+    assert (json_utf8_valid (&range) == expect);
+}
+
+static void _test_long_input ()
+{
+    char text[200];
+
+    memset (text, 'a', sizeof(text));
+
+    _test_valid (true, text, sizeof(text));
+
+    for (size_t i = 0; i + 1 < sizeof(text); i += 37)
+    {
+	text[i] = '\xc3';
+	text[i + 1] = '\xa9';
+    }
+
+    _test_valid (true, text, sizeof(text));
+
+    text[150] = '\xff';
+
+    _test_valid (false, text, sizeof(text));
+
+    text[150] = 'a';
+    text[sizeof(text) - 1] = '\xc3';
+
+    _test_valid (false, text, sizeof(text));
+}
+
+static void _test_parse ()
+{
+    const char * input = "{ \"caf\xc3\xa9\" : \"\\u00e9t\xc3\xa9\" }";
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse_utf8 (&text);
+
+    assert (value);
+    assert (value->type == JSON_OBJECT);
+
+    json_pair * pair = json_lookup_string (value->object, "caf\xc3\xa9");
+    assert (pair);
+    assert (pair->value.type == JSON_STRING);
+    assert (0 == strcmp (pair->value.string, "\xc3\xa9t\xc3\xa9"));
+
+    log_normal ("Parsed a %zd byte string", strlen (pair->value.string));
+
+    json_value_free (value);
+}
+
+int main()
+{
+    _test_valid (true, "", 0);
+    _test_valid (true, "plain ascii", 11);
+    _test_valid (true, "\xc3\xa9", 2);
+    _test_valid (true, "\xe2\x82\xac", 3);
+    _test_valid (true, "\xf0\x9f\x98\x80", 4);
+    _test_valid (true, "\xf4\x8f\xbf\xbf", 4);
+    _test_valid (false, "\x80", 1);
+    _test_valid (false, "\xc0\xaf", 2);
+    _test_valid (false, "\xe0\x80\xaf", 3);
+    _test_valid (false, "\xed\xa0\x80", 3);
+    _test_valid (false, "\xf4\x90\x80\x80", 4);
+    _test_valid (false, "\xf5\x80\x80\x80", 4);
+    _test_valid (false, "\xe2\x82", 2);
+    _test_long_input ();
+    _test_parse ();
+}
@@ -0,0 +1,138 @@
+#include "../writer.c"
+#include "../parse.h"
+#include "../../window/alloc.h"
+
+#include <assert.h>
+
+static bool _collect (void * arg, const char * bytes, size_t size)
+{
+    window_char * output = arg;
+
+    while (size--)
+    {
+	*window_push (*output) = *bytes++;
+    }
+
+    return true;
+}
+
+static void _finish (window_char * output, json_writer * writer)
+{
+    assert (json_writer_flush (writer));
+    *window_push (*output) = '\0';
+    output->region.end--;
+}
+
+static void _test_push ()
+{
+    window_char output = {0};
+    json_writer writer;
+
+    json_writer_init_sink (&writer, _collect, &output, true);
+
+    assert (json_writer_begin_object (&writer));
+    assert (json_writer_key (&writer, "name"));
+    assert (json_writer_string (&writer, "line\n\"quoted\"\t\x01"));
+    assert (json_writer_key (&writer, "values"));
+    assert (json_writer_begin_array (&writer));
+    assert (json_writer_number (&writer, 1));
+    assert (json_writer_number (&writer, -2.5));
+    assert (json_writer_number (&writer, 0.1));
+    assert (json_writer_bool (&writer, true));
+    assert (json_writer_null (&writer));
+    assert (json_writer_begin_object (&writer));
+    assert (json_writer_end_object (&writer));
+    assert (json_writer_end_array (&writer));
+    assert (json_writer_key (&writer, "empty"));
+    assert (json_writer_begin_array (&writer));
+    assert (json_writer_end_array (&writer));
+    assert (json_writer_end_object (&writer));
+
+    _finish (&output, &writer);
+
+    log_normal ("%s", output.region.begin);
+
+    free (output.alloc.begin);
+}
+
+static void _test_large ()
+{
+    window_char output = {0};
+    json_writer writer;
+    size_t count = 3 * JSON_WRITER_BUFFER_SIZE;
+
+    json_writer_init_sink (&writer, _collect, &output, false);
+
+    assert (json_writer_begin_array (&writer));
+
+    for (size_t i = 0; i < count; i++)
+    {
+	assert (json_writer_number (&writer, i));
+    }
+
+    assert (json_writer_end_array (&writer));
+
+    _finish (&output, &writer);
+
+    json_value * value = json_parse (&output.region.alias_const);
+    assert (value);
+    assert (value->type == JSON_ARRAY);
+    assert (value->count == count);
+    assert (value->elements[count - 1].number == count - 1);
+
+    log_normal ("Wrote %zd numbers in %zd bytes", count, (size_t) range_count (output.region));
+
+    json_value_free (value);
+    free (output.alloc.begin);
+}
+
+static void _test_value ()
+{
+    window_char output = {0};
+    json_writer writer;
+    const char * input = "[ { \"key\" : [ true, false, null, \"s\" ] }, 3 ]";
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse (&text);
+    assert (value);
+
+    json_writer_init_sink (&writer, _collect, &output, true);
+    assert (json_writer_value (&writer, value));
+    _finish (&output, &writer);
+
+    log_normal ("%s", output.region.begin);
+
+    json_value_free (value);
+    free (output.alloc.begin);
+}
+
+static void _test_forward_numbers ()
+{
+    window_char output = {0};
+    json_writer writer;
+    json_parser_context context = { .lazy_numbers = true };
+    const char * input = "{ \"id\" : 9007199254740993, \"ratio\" : 0.1000 }";
+    range_const_char text = { .begin = input, .end = input + strlen (input) };
+
+    json_value * value = json_parse_with (&context, &text);
+    assert (value);
+
+    json_writer_init_sink (&writer, _collect, &output, true);
+    assert (json_writer_value (&writer, value));
+    _finish (&output, &writer);
+
+    assert (strstr (output.region.begin, "\"id\":9007199254740993"));
+    assert (strstr (output.region.begin, "\"ratio\":0.1000"));
+
+    json_value_free (value);
+    json_parser_context_clear (&context);
+    free (output.alloc.begin);
+}
+
+int main()
+{
+    _test_push ();
+    _test_large ();
+    _test_value ();
+    _test_forward_numbers ();
+}
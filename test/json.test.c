@@ -55,9 +55,9 @@ void _print_value(int depth, const char * key, size_t index, json_value * value)
 
     case JSON_ARRAY:
 	log_normal("array:");
-	for_range(i_value, value->array)
+	for_range(i_value, json_elements (value))
 	{
-	    _print_value(depth + 1, NULL, range_index(i_value, value->array), i_value);
+	    _print_value(depth + 1, NULL, i_value - value->elements, i_value);
 	}
 	break;
 
@@ -242,12 +242,14 @@ static void _compare_values (json_value * a, json_value * b)
 
 static void _test_read_array (json_array * reference_array, const char * string, const char * remain)
 {
+    json_value read_value;
     json_array read_array;
-    json_tmp tmp = {0};
+    json_parser_context tmp = {0};
     range_const_char text;
     _bound_text (&text, string);
     assert (_identify_next(&text) == JSON_ARRAY);
-    assert (_read_array(&read_array, &text, &tmp));
+    assert (_read_array(&read_value, &text, &tmp));
+    read_array = json_elements (&read_value);
 
     assert (0 == strcmp (text.begin, remain));
 
@@ -261,7 +263,7 @@ static void _test_read_array (json_array * reference_array, const char * string,
 
     json_array_clear(&read_array);
     
-    free (tmp.text.alloc.begin);
+    json_parser_context_clear (&tmp);
 }
 
 static void _test_read_array_numbers()
@@ -299,7 +301,7 @@ static void _test_read_object(range_json_object_key_value * reference, const cha
 
     assert (_identify_next(&text) == JSON_OBJECT);
 
-    json_tmp tmp = {0};
+    json_parser_context tmp = {0};
     json_object * object = _read_object(&text, &tmp);
 
     assert (object);
@@ -319,7 +321,7 @@ static void _test_read_object(range_json_object_key_value * reference, const cha
     json_object_clear(object);
     free(object);
     
-    free (tmp.text.alloc.begin);
+    json_parser_context_clear (&tmp);
 }
 
 static void _test_read_object_numbers ()
@@ -353,11 +355,159 @@ static void _test_skip_string(const char * string, const char * skip, const char
     assert (0 == strcmp (text.begin, remain));
 }
 
+static void _test_parse_with ()
+{
+    json_parser_context context = {0};
+    range_const_char text;
+    const char * inputs[] = { "[ [ 1, 2 ], [ 3, [ 4, 5, 6 ] ], 7 ]",
+			      "{ \"a\" : [ \"x\", \"y\" ], \"b\" : [ ] }",
+			      "[ \"reused\", [ 8 ] ]" };
+    json_value * values[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+	_bound_text (&text, inputs[i]);
+	values[i] = json_parse_with (&context, &text);
+	assert (range_count (context.values.region) == 0);
+    }
+
+    assert (values[0] && values[0]->type == JSON_ARRAY);
+    assert (values[0]->count == 3);
+    assert (values[0]->elements[1].count == 2);
+    assert (values[0]->elements[1].elements[1].count == 3);
+    assert (values[0]->elements[1].elements[1].elements[2].number == 6);
+    assert (values[0]->elements[2].number == 7);
+
+    assert (values[1] && values[1]->type == JSON_OBJECT);
+    assert (json_get_array (.parent = values[1]->object, .key = "a")->count == 2);
+    assert (json_get_array (.parent = values[1]->object, .key = "b")->count == 0);
+    assert (!json_get_array (.parent = values[1]->object, .key = "missing", .optional = true));
+
+    assert (values[2] && values[2]->type == JSON_ARRAY);
+    assert (0 == strcmp (values[2]->elements[0].string, "reused"));
+    assert (values[2]->elements[1].elements[0].number == 8);
+
+    json_value_free (values[0]);
+    json_value_free (values[1]);
+    json_value_free (values[2]);
+
+    json_parser_context_clear (&context);
+}
+
+static void _test_lazy_numbers ()
+{
+    json_parser_context context = { .lazy_numbers = true };
+    range_const_char text;
+    range_const_char number;
+
+    _bound_text (&text, "[ 12345678901234567890, 1.5, -42, 2e3 ]");
+
+    json_value * value = json_parse_with (&context, &text);
+    assert (value);
+    assert (value->count == 4);
+
+    json_value * big = value->elements;
+    assert (big->type == JSON_NUMBER);
+    assert (json_number_text (&number, big));
+    assert (range_count (number) == 20);
+    assert (0 == strncmp (number.begin, "12345678901234567890", 20));
+    assert (json_number (big) > 1.2e19);
+    assert (big->flags & JSON_FLAG_NUMBER_BOXED);
+    assert (json_number (big) > 1.2e19);
+    assert (json_number_text (&number, big));
+    assert (0 == strncmp (number.begin, "12345678901234567890", 20));
+
+    assert (json_number (value->elements + 1) == 1.5);
+    assert (json_number_text (&number, value->elements + 1));
+
+    assert (json_number (value->elements + 2) == -42);
+    assert (!json_number_text (&number, value->elements + 2));
+    assert (value->elements[2].number == -42);
+
+    assert (json_number (value->elements + 3) == 2000);
+
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+static void _test_packed_numbers ()
+{
+    json_parser_context context = { .pack_numbers = true, .lazy_numbers = true };
+    range_const_char text;
+    json_number_array numbers;
+
+    _bound_text (&text, "{ \"ints\": [ 1, -2, 9007199254740993 ], \"reals\": [ 1, 2.5, -3e2 ], \"mixed\": [ 1, \"a\" ], \"empty\": [] } ");
+
+    json_value * value = json_parse_with (&context, &text);
+    assert (value);
+    assert (value->type == JSON_OBJECT);
+
+    bool success = true;
+    
+    numbers = json_get_number_array (value->object, "ints", .success = &success);
+    assert (success);
+    assert (numbers.integer);
+    assert (numbers.count == 3);
+    assert (numbers.integers[1] == -2);
+    assert (numbers.integers[2] == 9007199254740993LL);
+
+    numbers = json_get_number_array (value->object, "reals", .success = &success);
+    assert (success);
+    assert (!numbers.integer);
+    assert (numbers.count == 3);
+    assert (numbers.doubles[1] == 2.5);
+    assert (json_number_at (&numbers, 2) == -300);
+
+    const json_value * mixed = json_get_array (value->object, "mixed", .success = &success);
+    assert (success);
+    assert (!json_is_packed (mixed));
+    assert (range_count (json_elements (mixed)) == 2);
+
+    const json_value * ints = json_get_array (value->object, "ints", .success = &success);
+    assert (success);
+    assert (json_is_packed (ints));
+    assert (json_packed_numbers (ints).count == 3);
+
+    numbers = json_get_number_array (value->object, "empty", .success = &success);
+    assert (success);
+    assert (numbers.count == 0);
+
+    json_value_free (value);
+    json_parser_context_clear (&context);
+}
+
+static void _test_string_length ()
+{
+    range_const_char text;
+    range_const_char string;
+    bool success = true;
+
+    _bound_text (&text, "{ \"nul\": \"a\\u0000b\", \"plain\": \"text\" } ");
+
+    json_value * value = json_parse (&text);
+    assert (value);
+
+    string = json_get_string_range (value->object, "nul", .success = &success);
+    assert (success);
+    assert (range_count (string) == 3);
+    assert (0 == memcmp (string.begin, "a\0b", 3));
+
+    string = json_get_string_range (value->object, "plain", .success = &success);
+    assert (success);
+    assert (range_count (string) == 4);
+    assert (json_lookup_string (value->object, "plain")->value.count == 4);
+
+    json_value_free (value);
+}
+
 int main()
 {
     _test_identify_next ();
     _test_string ("  \"this is a string\"  asdf", "this is a string", "  asdf");
     _test_string ("   \"this \\\"is\\\" a string with escaped quotes\"   1234  ", "this \"is\" a string with escaped quotes", "   1234  ");
+    _test_string ("\"a \\\\ backslash\" x", "a \\ backslash", " x");
+    _test_string ("\"\\u0041\\u00e9\\u20AC\" x", "A\xc3\xa9\xe2\x82\xac", " x");
+    _test_string ("\"\\ud83d\\ude00\"", "\xf0\x9f\x98\x80", "");
     _test_number ("        1000   ", 1000, "   ");
     _test_number ("    5.23e+2  77", 523, "  77");
     _test_number ("  1.23   ", 1.23, "   ");
@@ -371,4 +521,9 @@ int main()
     _test_read_object_numbers_strings ();
     
     _test_skip_string ("asdf bcle", "asdf", " bcle");
+
+    _test_parse_with ();
+    _test_lazy_numbers ();
+    _test_packed_numbers ();
+    _test_string_length ();
 }
@@ -1,11 +1,51 @@
 #ifndef FLAT_INCLUDES
 #include "def.h"
+#include "shape.h"
 #include "../keyargs/keyargs.h"
 #include <stdbool.h>
 #endif
 
 //json_value * json_lookup (const json_object * object, const char * key);
 const char * json_type_name(json_type type);
+double json_number (const json_value * value); // converts and caches a lazy number in place, so it is not thread safe on trees that are not frozen
+bool json_number_text (range_const_char * text, const json_value * value);
+
+typedef struct json_number_array json_number_array;
+struct json_number_array {
+    bool integer;
+    size_t count;
+    union {
+	const double * doubles;
+	const int64_t * integers;
+    };
+};
+
+json_number_array json_packed_numbers (const json_value * value);
+double json_number_at (const json_number_array * array, size_t index);
+
+// Field access that works on both table and shaped objects. A cache remembers the slot of its key in the last shape it saw, so give each call site (and thread) its own.
+const json_value * json_field (const json_value * object, const char * key);
+
+typedef struct json_field_cache json_field_cache;
+struct json_field_cache {
+    const json_shape * shape;
+    uint32_t slot;
+};
+
+const json_value * json_field_cached (const json_value * object, const char * key, json_field_cache * cache);
+
+typedef struct json_field_iterator json_field_iterator;
+struct json_field_iterator {
+    const json_value * object;
+    size_t index;
+    const json_link * link;
+    range_const_char key;
+    const json_value * value;
+};
+
+#define json_field_iterator(input) ((json_field_iterator){ .object = json_resolve (input) })
+bool json_field_next (json_field_iterator * fields);
+size_t json_object_size (const json_value * object);
 
 #define json_get_number(...) keyargs_call(json_get_number, __VA_ARGS__)
 keyargs_declare(double, json_get_number, 
@@ -31,8 +71,32 @@ keyargs_declare(const char*, json_get_string,
 		bool optional;
 		const char * default_value;);
 
+range_const_char json_string_range (const json_value * value);
+
+#define json_get_string_range(...) keyargs_call(json_get_string_range, __VA_ARGS__)
+keyargs_declare(range_const_char, json_get_string_range,
+		const json_object * parent;
+		const char * key;
+		bool * success;
+		bool optional;
+		const char * default_value;);
+
+/*
+  json_get_array returns the array value itself, NULL for a missing
+  optional member, so an empty array is still told apart. Iterate it
+  with json_elements, or read a packed number array (json_is_packed)
+  with json_packed_numbers, or with json_get_number_array directly.
+*/
+
 #define json_get_array(...) keyargs_call(json_get_array, __VA_ARGS__)
-keyargs_declare(const json_array*, json_get_array,
+keyargs_declare(const json_value*, json_get_array,
+		const json_object * parent;
+		const char * key;
+		bool optional;
+		bool * success;);
+
+#define json_get_number_array(...) keyargs_call(json_get_number_array, __VA_ARGS__)
+keyargs_declare(json_number_array, json_get_number_array,
 		const json_object * parent;
 		const char * key;
 		bool optional;
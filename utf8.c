@@ -0,0 +1,156 @@
+#include "utf8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const unsigned char * _skip_ascii (const unsigned char * i, const unsigned char * end)
+{
+#if defined(__AVX2__)
+    while (end - i >= 32)
+    {
+	int mask = _mm256_movemask_epi8 (_mm256_loadu_si256 ((const __m256i*) i));
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    while (end - i >= 16)
+    {
+	int mask = _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*) i));
+
+	if (mask)
+	{
+	    return i + __builtin_ctz (mask);
+	}
+
+	i += 16;
+    }
+#else
+    uint64_t word;
+
+    while (end - i >= 8)
+    {
+	memcpy (&word, i, sizeof(word));
+
+	if (word & 0x8080808080808080ULL)
+	{
+	    break;
+	}
+
+	i += 8;
+    }
+#endif
+
+    while (i < end && *i < 0x80)
+    {
+	i++;
+    }
+
+    return i;
+}
+
+static const unsigned char * _skip_sequence (const unsigned char * i, const unsigned char * end)
+{
+    unsigned char lead = *i;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    int continuation;
+
+    if (lead < 0xc2)
+    {
+	return NULL;
+    }
+    else if (lead < 0xe0)
+    {
+	continuation = 1;
+    }
+    else if (lead < 0xf0)
+    {
+	continuation = 2;
+
+	if (lead == 0xe0)
+	{
+	    low = 0xa0;
+	}
+	else if (lead == 0xed)
+	{
+	    high = 0x9f;
+	}
+    }
+    else if (lead < 0xf5)
+    {
+	continuation = 3;
+
+	if (lead == 0xf0)
+	{
+	    low = 0x90;
+	}
+	else if (lead == 0xf4)
+	{
+	    high = 0x8f;
+	}
+    }
+    else
+    {
+	return NULL;
+    }
+
+    if (end - i <= continuation)
+    {
+	return NULL;
+    }
+
+    i++;
+
+    if (*i < low || *i > high)
+    {
+	return NULL;
+    }
+
+    while (continuation--)
+    {
+	if ((*i & 0xc0) != 0x80)
+	{
+	    return NULL;
+	}
+
+	i++;
+    }
+
+    return i;
+}
+
+bool json_utf8_valid (const range_const_char * text)
+{
+    const unsigned char * i = (const unsigned char*) text->begin;
+    const unsigned char * end = (const unsigned char*) text->end;
+
+    while (true)
+    {
+	i = _skip_ascii (i, end);
+
+	if (i == end)
+	{
+	    return true;
+	}
+
+	i = _skip_sequence (i, end);
+
+	if (!i)
+	{
+	    return false;
+	}
+    }
+}
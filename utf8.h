@@ -0,0 +1,6 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include "../range/def.h"
+#endif
+
+bool json_utf8_valid (const range_const_char * text);
@@ -0,0 +1,70 @@
+#include "../index.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../log/log.h"
+
+static void _usage (const char * program)
+{
+    fprintf (stderr, "usage: %s [-d depth] source.json [index]\n"
+	     "Builds a sidecar index of the top level elements or members of source.json,\n"
+	     "and of their children down to depth levels (default 1). The index is written\n"
+	     "to source.json.idx unless another path is given.\n", program);
+}
+
+int main (int argc, char * argv[])
+{
+    int depth = 1;
+    int arg = 1;
+    char * index_path = NULL;
+    const char * source_path;
+    json_index index;
+
+    if (arg + 1 < argc && 0 == strcmp (argv[arg], "-d"))
+    {
+	depth = atoi (argv[arg + 1]);
+	arg += 2;
+    }
+
+    if (arg >= argc || argc - arg > 2 || depth < 1)
+    {
+	_usage (argv[0]);
+	return 1;
+    }
+
+    source_path = argv[arg];
+
+    if (arg + 1 < argc)
+    {
+	index_path = strdup (argv[arg + 1]);
+    }
+    else if ((index_path = malloc (strlen (source_path) + 5)))
+    {
+	strcpy (index_path, source_path);
+	strcat (index_path, ".idx");
+    }
+
+    if (!index_path)
+    {
+	perror ("malloc");
+	return 1;
+    }
+
+    if (!json_index_build (source_path, index_path, depth) || !json_index_open (&index, source_path, index_path))
+    {
+	log_fatal ("Could not index %s", source_path);
+    }
+
+    log_normal ("Indexed %zu top level entries of %s into %s", json_index_count (&index, JSON_INDEX_ROOT), source_path, index_path);
+
+    json_index_close (&index);
+    free (index_path);
+
+    return 0;
+
+fail:
+    free (index_path);
+    return 1;
+}
@@ -0,0 +1,235 @@
+#include "../query.h"
+#include "../parse.h"
+#include "../writer.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../log/log.h"
+
+static void _usage (const char * program)
+{
+    fprintf (stderr, "usage: %s [options] source.json\n"
+	     "Filters the records of source.json, either NDJSON or a top level array,\n"
+	     "and prints the matching ones or aggregates over them.\n"
+	     "  -t threads               worker threads (default one per processor)\n"
+	     "  -w path op value         keep records where path op value holds, with op one of\n"
+	     "                           == != < <= > >= and value in JSON\n"
+	     "  -e path                  keep records that have path\n"
+	     "  -s path                  print path instead of the whole record\n"
+	     "  -g path                  group the records by the value at path\n"
+	     "  -a name sum|min|max path aggregate path into name for each group\n", program);
+}
+
+static bool _op (json_query_op * op, const char * text)
+{
+    static const char * names[] = { "==", "!=", "<", "<=", ">", ">=" };
+    static const json_query_op ops[] = { JSON_QUERY_EQ, JSON_QUERY_NE, JSON_QUERY_LT, JSON_QUERY_LE, JSON_QUERY_GT, JSON_QUERY_GE };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++)
+    {
+	if (0 == strcmp (names[i], text))
+	{
+	    *op = ops[i];
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+static bool _function (json_query_function * function, const char * text)
+{
+    if (0 == strcmp (text, "sum"))
+    {
+	*function = JSON_QUERY_SUM;
+    }
+    else if (0 == strcmp (text, "min"))
+    {
+	*function = JSON_QUERY_MIN;
+    }
+    else if (0 == strcmp (text, "max"))
+    {
+	*function = JSON_QUERY_MAX;
+    }
+    else
+    {
+	return false;
+    }
+
+    return true;
+}
+
+static bool _value (json_value * value, const char * text)
+{
+    range_const_char range = { .begin = text, .end = text + strlen (text) };
+    range_const_char rest = range;
+    json_parser_context context = {0};
+    json_value * parsed;
+    bool valid;
+
+    // The parser asserts on input that is not a value at all, so the argument is checked with the scanner first
+    valid = json_skip_value (&context, &rest);
+    json_parser_context_clear (&context);
+    json_scan_next (&rest);
+
+    if (!valid || rest.begin != rest.end || !(parsed = json_parse (&range)))
+    {
+	return false;
+    }
+
+    *value = *parsed;
+    free (parsed);
+
+    return true;
+}
+
+int main (int argc, char * argv[])
+{
+    json_query_predicate * where = calloc (argc, sizeof(*where));
+    const char ** select = calloc (argc, sizeof(*select));
+    json_query_aggregate * aggregates = calloc (argc, sizeof(*aggregates));
+    json_query query = { .where = where, .select = select, .aggregates = aggregates };
+    json_query_result result = {0};
+    json_writer writer;
+    range_const_char input = {0};
+    struct stat info;
+    size_t size = 0;
+    void * map = MAP_FAILED;
+    int fd;
+    int arg = 1;
+    int status = 1;
+
+    if (!where || !select || !aggregates)
+    {
+	perror ("calloc");
+	goto fail;
+    }
+
+    for (; arg < argc - 1 && argv[arg][0] == '-'; arg++)
+    {
+	if (0 == strcmp (argv[arg], "-t") && arg + 1 < argc - 1)
+	{
+	    query.threads = atoi (argv[++arg]);
+	}
+	else if (0 == strcmp (argv[arg], "-w") && arg + 3 < argc - 1)
+	{
+	    where[query.where_count].path = argv[arg + 1];
+
+	    if (!_op (&where[query.where_count].op, argv[arg + 2]) || !_value (&where[query.where_count].value, argv[arg + 3]))
+	    {
+		log_fatal ("Bad predicate %s %s %s", argv[arg + 1], argv[arg + 2], argv[arg + 3]);
+	    }
+
+	    query.where_count++;
+	    arg += 3;
+	}
+	else if (0 == strcmp (argv[arg], "-e") && arg + 1 < argc - 1)
+	{
+	    where[query.where_count++] = (json_query_predicate){ .path = argv[++arg], .op = JSON_QUERY_EXISTS };
+	}
+	else if (0 == strcmp (argv[arg], "-s") && arg + 1 < argc - 1)
+	{
+	    select[query.select_count++] = argv[++arg];
+	}
+	else if (0 == strcmp (argv[arg], "-g") && arg + 1 < argc - 1)
+	{
+	    query.group_by = argv[++arg];
+	}
+	else if (0 == strcmp (argv[arg], "-a") && arg + 3 < argc - 1)
+	{
+	    aggregates[query.aggregate_count] = (json_query_aggregate){ .name = argv[arg + 1], .path = argv[arg + 3] };
+
+	    if (!_function (&aggregates[query.aggregate_count].function, argv[arg + 2]))
+	    {
+		log_fatal ("Unknown aggregate %s", argv[arg + 2]);
+	    }
+
+	    query.aggregate_count++;
+	    arg += 3;
+	}
+	else
+	{
+	    break;
+	}
+    }
+
+    if (arg != argc - 1)
+    {
+	_usage (argv[0]);
+	goto fail;
+    }
+
+    fd = open (argv[arg], O_RDONLY);
+
+    if (fd < 0)
+    {
+	perror (argv[arg]);
+	goto fail;
+    }
+
+    if (0 != fstat (fd, &info))
+    {
+	perror (argv[arg]);
+	close (fd);
+	goto fail;
+    }
+
+    size = info.st_size;
+    map = size ? mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close (fd);
+
+    if (map == MAP_FAILED)
+    {
+	perror ("mmap");
+	goto fail;
+    }
+
+    input = (range_const_char){ .begin = map, .end = (const char*) map + size };
+
+    if (!json_query_run (&result, &query, &input))
+    {
+	log_fatal ("Could not query %s", argv[arg]);
+    }
+
+    if (result.groups.type == JSON_ARRAY)
+    {
+	json_writer_init_fd (&writer, 1, false);
+
+	if (!json_writer_value (&writer, &result.groups) || !json_writer_flush (&writer) || 1 != write (1, "\n", 1))
+	{
+	    log_fatal ("Could not write the groups");
+	}
+    }
+    else if (!range_is_empty (result.rows.region) && range_count (result.rows.region) != fwrite (result.rows.region.begin, 1, range_count (result.rows.region), stdout))
+    {
+	perror ("fwrite");
+	goto fail;
+    }
+
+    status = 0;
+
+fail:
+    json_query_result_clear (&result);
+
+    if (map && map != MAP_FAILED)
+    {
+	munmap (map, size);
+    }
+
+    for (size_t i = 0; where && i < query.where_count; i++)
+    {
+	json_value_clear (&where[i].value);
+    }
+
+    free (where);
+    free (select);
+    free (aggregates);
+
+    return status;
+}
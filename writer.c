@@ -0,0 +1,471 @@
+#include "writer.h"
+#include "traverse.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../log/log.h"
+
+#define JSON_WRITER_OBJECT 1
+#define JSON_WRITER_ARRAY 2
+
+static bool _write_fd (void * arg, const char * bytes, size_t size)
+{
+    int fd = *(int*) arg;
+    ssize_t wrote;
+
+    while (size)
+    {
+	wrote = write (fd, bytes, size);
+
+	if (wrote < 0)
+	{
+	    if (errno == EINTR)
+	    {
+		continue;
+	    }
+
+	    perror ("write");
+	    return false;
+	}
+
+	bytes += wrote;
+	size -= wrote;
+    }
+
+    return true;
+}
+
+void json_writer_init_fd (json_writer * writer, int fd, bool check_nesting)
+{
+    json_writer_init_sink (writer, _write_fd, NULL, check_nesting);
+    writer->fd = fd;
+    writer->arg = &writer->fd;
+}
+
+void json_writer_init_sink (json_writer * writer, json_writer_sink sink, void * arg, bool check_nesting)
+{
+    writer->sink = sink;
+    writer->arg = arg;
+    writer->fd = -1;
+    writer->check_nesting = check_nesting;
+    writer->failed = false;
+    writer->need_comma = false;
+    writer->after_key = false;
+    writer->depth = 0;
+    writer->fill = 0;
+}
+
+bool json_writer_flush (json_writer * writer)
+{
+    if (writer->failed)
+    {
+	return false;
+    }
+
+    if (writer->fill && !writer->sink (writer->arg, writer->buffer, writer->fill))
+    {
+	writer->failed = true;
+	return false;
+    }
+
+    writer->fill = 0;
+
+    return true;
+}
+
+static bool _write (json_writer * writer, const char * bytes, size_t size)
+{
+    size_t space;
+
+    while (size)
+    {
+	space = sizeof(writer->buffer) - writer->fill;
+
+	if (!space)
+	{
+	    if (!json_writer_flush (writer))
+	    {
+		return false;
+	    }
+
+	    continue;
+	}
+
+	if (space > size)
+	{
+	    space = size;
+	}
+
+	memcpy (writer->buffer + writer->fill, bytes, space);
+	writer->fill += space;
+	bytes += space;
+	size -= space;
+    }
+
+    return true;
+}
+
+static bool _write_c (json_writer * writer, char c)
+{
+    if (writer->fill == sizeof(writer->buffer) && !json_writer_flush (writer))
+    {
+	return false;
+    }
+
+    writer->buffer[writer->fill++] = c;
+
+    return true;
+}
+
+static unsigned char _container (json_writer * writer)
+{
+    return writer->depth ? writer->stack[writer->depth - 1] : 0;
+}
+
+static bool _begin_value (json_writer * writer)
+{
+    if (writer->failed)
+    {
+	return false;
+    }
+
+    if (writer->after_key)
+    {
+	writer->after_key = false;
+	writer->need_comma = true;
+	return true;
+    }
+
+    if (writer->check_nesting)
+    {
+	if (_container (writer) == JSON_WRITER_OBJECT)
+	{
+	    writer->failed = true;
+	    log_fatal ("A value inside of an object must follow a key");
+	}
+
+	if (!writer->depth && writer->need_comma)
+	{
+	    writer->failed = true;
+	    log_fatal ("Only one value may be written outside of a container");
+	}
+    }
+
+    if (writer->need_comma && writer->depth && !_write_c (writer, ','))
+    {
+	return false;
+    }
+
+    writer->need_comma = true;
+
+    return true;
+
+fail:
+    return false;
+}
+
+static bool _begin_container (json_writer * writer, unsigned char type, char c)
+{
+    if (!_begin_value (writer))
+    {
+	return false;
+    }
+
+    if (writer->depth == JSON_WRITER_MAX_DEPTH)
+    {
+	writer->failed = true;
+	log_fatal ("JSON writer nesting is deeper than %d", JSON_WRITER_MAX_DEPTH);
+    }
+
+    writer->stack[writer->depth++] = type;
+    writer->need_comma = false;
+
+    return _write_c (writer, c);
+
+fail:
+    return false;
+}
+
+static bool _end_container (json_writer * writer, unsigned char type, char c)
+{
+    if (writer->failed)
+    {
+	return false;
+    }
+
+    if (!writer->depth || (writer->check_nesting && (_container (writer) != type || writer->after_key)))
+    {
+	writer->failed = true;
+	log_fatal ("Mismatched end of %s in JSON writer", type == JSON_WRITER_OBJECT ? "object" : "array");
+    }
+
+    writer->depth--;
+    writer->need_comma = true;
+
+    return _write_c (writer, c);
+
+fail:
+    return false;
+}
+
+bool json_writer_begin_object (json_writer * writer)
+{
+    return _begin_container (writer, JSON_WRITER_OBJECT, '{');
+}
+
+bool json_writer_end_object (json_writer * writer)
+{
+    return _end_container (writer, JSON_WRITER_OBJECT, '}');
+}
+
+bool json_writer_begin_array (json_writer * writer)
+{
+    return _begin_container (writer, JSON_WRITER_ARRAY, '[');
+}
+
+bool json_writer_end_array (json_writer * writer)
+{
+    return _end_container (writer, JSON_WRITER_ARRAY, ']');
+}
+
+static bool _write_escaped (json_writer * writer, const char * string, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char * end = string + size;
+    const char * run = string;
+    char escape[6] = { '\\', 'u', '0', '0' };
+    unsigned char c;
+
+    if (!_write_c (writer, '"'))
+    {
+	return false;
+    }
+
+    for (; string < end; string++)
+    {
+	c = (unsigned char) *string;
+
+	if (c >= 0x20 && c != '"' && c != '\\')
+	{
+	    continue;
+	}
+
+	if (!_write (writer, run, string - run))
+	{
+	    return false;
+	}
+
+	run = string + 1;
+
+	switch (c)
+	{
+	case '"': escape[1] = '"'; break;
+	case '\\': escape[1] = '\\'; break;
+	case '\b': escape[1] = 'b'; break;
+	case '\f': escape[1] = 'f'; break;
+	case '\n': escape[1] = 'n'; break;
+	case '\r': escape[1] = 'r'; break;
+	case '\t': escape[1] = 't'; break;
+	default:
+	    escape[1] = 'u';
+	    escape[4] = hex[c >> 4];
+	    escape[5] = hex[c & 0xf];
+
+	    if (!_write (writer, escape, 6))
+	    {
+		return false;
+	    }
+
+	    continue;
+	}
+
+	if (!_write (writer, escape, 2))
+	{
+	    return false;
+	}
+    }
+
+    return _write (writer, run, string - run) && _write_c (writer, '"');
+}
+
+bool json_writer_key (json_writer * writer, const char * key)
+{
+    if (writer->failed)
+    {
+	return false;
+    }
+
+    if (writer->check_nesting && (_container (writer) != JSON_WRITER_OBJECT || writer->after_key))
+    {
+	writer->failed = true;
+	log_fatal ("A key may only be written inside of an object, before its value: %s", key);
+    }
+
+    if (writer->need_comma && !_write_c (writer, ','))
+    {
+	return false;
+    }
+
+    writer->after_key = true;
+    writer->need_comma = false;
+
+    return _write_escaped (writer, key, strlen (key)) && _write_c (writer, ':');
+
+fail:
+    return false;
+}
+
+bool json_writer_string (json_writer * writer, const char * string)
+{
+    return _begin_value (writer) && _write_escaped (writer, string, strlen (string));
+}
+
+bool json_writer_string_range (json_writer * writer, const range_const_char * string)
+{
+    return _begin_value (writer) && _write_escaped (writer, string->begin, range_count (*string));
+}
+
+bool json_writer_number (json_writer * writer, double number)
+{
+    char text[32];
+    int size;
+
+    if (!isfinite (number))
+    {
+	return json_writer_null (writer);
+    }
+
+    size = snprintf (text, sizeof(text), "%.15g", number);
+
+    if (strtod (text, NULL) != number)
+    {
+	size = snprintf (text, sizeof(text), "%.17g", number);
+    }
+
+    return _begin_value (writer) && _write (writer, text, size);
+}
+
+bool json_writer_number_text (json_writer * writer, const range_const_char * text)
+{
+    return _begin_value (writer) && _write (writer, text->begin, range_count (*text));
+}
+
+bool json_writer_bool (json_writer * writer, bool value)
+{
+    return _begin_value (writer) && (value ? _write (writer, "true", 4) : _write (writer, "false", 5));
+}
+
+bool json_writer_null (json_writer * writer)
+{
+    return _begin_value (writer) && _write (writer, "null", 4);
+}
+
+static bool _write_packed_numbers (json_writer * writer, const json_value * array)
+{
+    char text[32];
+    int size;
+
+    for (size_t i = 0; i < array->count; i++)
+    {
+	if (array->flags & JSON_FLAG_PACKED_INT64)
+	{
+	    size = snprintf (text, sizeof(text), "%lld", (long long) array->integers[i]);
+
+	    if (!_begin_value (writer) || !_write (writer, text, size))
+	    {
+		return false;
+	    }
+	}
+	else if (!json_writer_number (writer, array->doubles[i]))
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+bool json_writer_value (json_writer * writer, const json_value * value)
+{
+    const json_value * element;
+    range_const_char string;
+    range_const_char text;
+    json_field_iterator fields;
+
+    value = json_resolve (value);
+
+    switch (value->type)
+    {
+    case JSON_NULL:
+	return json_writer_null (writer);
+
+    case JSON_TRUE:
+	return json_writer_bool (writer, true);
+
+    case JSON_FALSE:
+	return json_writer_bool (writer, false);
+
+    case JSON_NUMBER:
+	if (json_number_text (&text, value))
+	{
+	    return json_writer_number_text (writer, &text);
+	}
+	return json_writer_number (writer, value->number);
+
+    case JSON_STRING:
+	string = json_string_range (value);
+	return json_writer_string_range (writer, &string);
+
+    case JSON_ARRAY:
+	if (!json_writer_begin_array (writer))
+	{
+	    return false;
+	}
+
+	if (json_is_packed (value))
+	{
+	    return _write_packed_numbers (writer, value) && json_writer_end_array (writer);
+	}
+
+	for_range (element, json_elements (value))
+	{
+	    if (!json_writer_value (writer, element))
+	    {
+		return false;
+	    }
+	}
+
+	return json_writer_end_array (writer);
+
+    case JSON_OBJECT:
+	if (!json_writer_begin_object (writer))
+	{
+	    return false;
+	}
+
+	fields = json_field_iterator (value);
+
+	while (json_field_next (&fields))
+	{
+	    if (!json_writer_key (writer, fields.key.begin)
+		|| !json_writer_value (writer, fields.value))
+	    {
+		return false;
+	    }
+	}
+
+	return json_writer_end_object (writer);
+
+    default:
+	writer->failed = true;
+	log_fatal ("Cannot write a value of type %s", json_type_name (value->type));
+    }
+
+fail:
+    return false;
+}
@@ -0,0 +1,51 @@
+#ifndef FLAT_INCLUDES
+#include <stdbool.h>
+#include <stddef.h>
+#include "def.h"
+#endif
+
+/*
+  A push style JSON writer. Output collects in a fixed buffer inside the
+  writer and is handed to a file descriptor or a sink callback whenever
+  it fills, so memory use does not depend on the size of the output.
+  With check_nesting set, keys outside of objects, values without keys
+  inside of objects and mismatched ends are refused. Once a call fails
+  every later call fails as well.
+*/
+
+#define JSON_WRITER_BUFFER_SIZE 4096
+#define JSON_WRITER_MAX_DEPTH 256
+
+typedef bool (*json_writer_sink) (void * arg, const char * bytes, size_t size);
+
+typedef struct json_writer json_writer;
+struct json_writer {
+    json_writer_sink sink;
+    void * arg;
+    int fd;
+    bool check_nesting;
+    bool failed;
+    bool need_comma;
+    bool after_key;
+    size_t depth;
+    size_t fill;
+    unsigned char stack[JSON_WRITER_MAX_DEPTH];
+    char buffer[JSON_WRITER_BUFFER_SIZE];
+};
+
+void json_writer_init_fd (json_writer * writer, int fd, bool check_nesting);
+void json_writer_init_sink (json_writer * writer, json_writer_sink sink, void * arg, bool check_nesting);
+
+bool json_writer_begin_object (json_writer * writer);
+bool json_writer_end_object (json_writer * writer);
+bool json_writer_begin_array (json_writer * writer);
+bool json_writer_end_array (json_writer * writer);
+bool json_writer_key (json_writer * writer, const char * key);
+bool json_writer_string (json_writer * writer, const char * string);
+bool json_writer_string_range (json_writer * writer, const range_const_char * string);
+bool json_writer_number (json_writer * writer, double number);
+bool json_writer_number_text (json_writer * writer, const range_const_char * text);
+bool json_writer_bool (json_writer * writer, bool value);
+bool json_writer_null (json_writer * writer);
+bool json_writer_value (json_writer * writer, const json_value * value);
+bool json_writer_flush (json_writer * writer);